@@ -14,6 +14,7 @@
 
 #pragma once
 #include <memory>
+#include "options.h"
 #include "socket.h"
 
 namespace NetworkFramework {
@@ -21,11 +22,25 @@ namespace NetworkFramework {
 /// @brief Connect to a server.
 /// @param address_remote The IP address of the server. Only IPv4 is supported currently.
 /// @param port_remote The port number of the server.
+/// @param retry_count The number of attempts to connect, one second apart.
+/// @param options The options of the connection.
 /// @return A socket that is connected to the server.
 /// @throw ConnectionEstablishmentException if the connection could not be established.
 std::unique_ptr<Socket> ConnectToServer(
     const std::string& address_remote,
     int port_remote,
-    int retry_count = 3);
+    int retry_count = 3,
+    const ConnectionOptions& options = ConnectionOptions());
+
+/// @brief Connect to a server, with the kernel options of the socket.
+/// @param address_remote The IP address of the server. Only IPv4 is supported currently.
+/// @param port_remote The port number of the server.
+/// @param options The options of the client and of the connection.
+/// @return A socket that is connected to the server.
+/// @throw ConnectionEstablishmentException if the connection could not be established, or an option could not be set.
+std::unique_ptr<Socket> ConnectToServer(
+    const std::string& address_remote,
+    int port_remote,
+    const ConnectOptions& options);
 
 }  // namespace NetworkFramework
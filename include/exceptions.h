@@ -11,6 +11,7 @@
  */
 
 #pragma once
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 
@@ -101,4 +102,21 @@ class BindPortException final : public BaseException {
     std::string details_;
 };
 
+/// @brief An exception that is thrown when a peer exceeds a receive limit, such as the maximum message size.
+/// The connection is closed before the exception is thrown.
+class ReceiveLimitExceededException final : public BaseException {
+   public:
+    ReceiveLimitExceededException(const std::string& limit_name, std::size_t limit);
+
+    const char* what() const noexcept override;
+
+    std::string LimitName() const noexcept;
+    std::size_t Limit() const noexcept;
+
+   private:
+    std::string what_;
+    std::string limit_name_;
+    std::size_t limit_;
+};
+
 }  // namespace NetworkFramework
@@ -0,0 +1,89 @@
+/*
+ *  Description: This file defines NetworkFramework::Matchmaker,
+ *               which groups waiting connections into matches.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "socket.h"
+
+namespace NetworkFramework {
+
+class MatchmakerImpl;
+
+/// @brief Options of a matchmaker.
+struct MatchmakerOptions {
+    /// @brief The number of players in a match.
+    std::size_t players_per_match = 2;
+
+    /// @brief The number of independently locked shards. Each pool is kept in one shard.
+    std::size_t shard_count = 16;
+
+    /// @brief Remove a player from its pool if no match is formed for this long. 0 means wait forever.
+    std::chrono::milliseconds wait_timeout{0};
+};
+
+/// @brief Groups waiting players into matches of a fixed size.
+///
+/// Players wait in pools, e.g. one pool per game mode or rating bracket,
+/// and only players of the same pool are matched together.
+/// Pools are spread over shards, so players of different shards never contend for the same lock.
+/// No thread is blocked while a player is waiting: one thread of the matchmaker watches the connections
+/// of all waiting players, and removes a player whose peer closes the connection (on Linux).
+class Matchmaker {
+   public:
+    /// @brief Identifies a waiting player.
+    typedef std::uint64_t Ticket;
+
+    /// @brief Called with the players of a match, in the order they joined.
+    /// It is called in the thread whose Enqueue() completed the match,
+    /// so it should hand the match over quickly, e.g. to another thread.
+    typedef std::function<void(std::vector<std::shared_ptr<Socket>> players)> MatchHandler;
+
+    /// @brief Called with a player that waited longer than MatchmakerOptions::wait_timeout.
+    /// It is called in the timer thread of the matchmaker, so it should return quickly.
+    typedef std::function<void(std::shared_ptr<Socket> player)> TimeoutHandler;
+
+    /// @brief Create a matchmaker.
+    /// @param on_match The handler of formed matches.
+    /// @param options The options of the matchmaker.
+    /// @param on_timeout The handler of timed out players, may be empty.
+    Matchmaker(MatchHandler on_match,
+               const MatchmakerOptions& options = MatchmakerOptions(),
+               TimeoutHandler on_timeout = nullptr);
+
+    /// @brief Close the sockets of the players that are still waiting.
+    ~Matchmaker();
+
+    /// @brief Add a player to a pool. Returns immediately, and forms a match if enough players are waiting.
+    /// @param player The socket of the player.
+    /// @param pool The pool to wait in.
+    /// @return A ticket that can be used to cancel waiting.
+    Ticket Enqueue(std::shared_ptr<Socket> player, std::uint64_t pool = 0);
+
+    /// @brief Remove a waiting player, e.g. when it asks to leave the queue.
+    /// @param ticket The ticket returned by Enqueue().
+    /// @return false if the player is already matched, timed out, disconnected or canceled.
+    bool Cancel(Ticket ticket);
+
+    /// @brief Get the number of waiting players in all pools.
+    /// @return The number of waiting players.
+    std::size_t WaitingCount() const;
+
+   private:
+    std::unique_ptr<MatchmakerImpl> impl_;
+};
+
+}  // namespace NetworkFramework
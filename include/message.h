@@ -15,11 +15,13 @@
 // See: https://github.com/panjd123/Surakarta/blob/main/network/src/networkdata.h
 
 #pragma once
+#include <cstdint>
 #include <string>
 
 namespace NetworkFramework {
 
 /// @brief The different types of messages that can be sent.
+/// The 256 smallest values, starting from INT_MIN, are reserved by the network framework.
 typedef int Opcode;
 
 /// @brief A message that can be sent over the network.
@@ -28,12 +30,17 @@ struct Message {
     std::string data1;
     std::string data2;
     std::string data3;
+    /// @brief Pairs a response with its request, see rpc.h. 0 if the message is not part of a call,
+    /// in which case it is not sent, so peers that do not know it are not affected.
+    std::uint64_t correlation_id = 0;
 
     Message(Opcode opcode = 0, const std::string& data1 = "", const std::string& data2 = "", const std::string& data3 = "")
         : opcode(opcode), data1(data1), data2(data2), data3(data3) {}
 
+    /// @brief Two messages are equal if their opcodes, data fields and correlation IDs are.
     bool operator==(const Message& other) const {
-        return opcode == other.opcode && data1 == other.data1 && data2 == other.data2 && data3 == other.data3;
+        return opcode == other.opcode && data1 == other.data1 && data2 == other.data2 && data3 == other.data3 &&
+               correlation_id == other.correlation_id;
     }
 };
 
@@ -0,0 +1,93 @@
+/*
+ *  Description: This file defines NetworkFramework::MessageView,
+ *               a received message that refers to the receive buffer
+ *               of its socket instead of copying it.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "message.h"
+
+namespace NetworkFramework {
+
+/// @brief A message returned by Socket::ReceiveView().
+///
+/// It borrows the receive buffer of the socket, so it is only valid until the next
+/// call of Receive() or ReceiveView() on that socket, and must not be used after that.
+/// The opcode is decoded when the message is received, but the data fields are only
+/// located and decoded when one of them is accessed for the first time, so a message
+/// that is routed or dropped by its opcode costs nothing for its data.
+///
+/// A MessageView is not thread safe, even if it is const.
+class MessageView {
+   public:
+    /// @brief The opcode of the message.
+    Opcode opcode;
+
+    /// @brief The correlation ID of the message, see Message::correlation_id.
+    std::uint64_t correlation_id;
+
+    /// @brief Refer to a message that is already decoded.
+    /// @param message The message, which must outlive this view.
+    explicit MessageView(const Message& message)
+        : opcode(message.opcode),
+          correlation_id(message.correlation_id),
+          fields_{message.data1, message.data2, message.data3},
+          decoded_(true) {}
+
+    /// @brief Refer to an encoded frame, whose data fields are decoded when accessed.
+    /// Used by the sockets that implement Socket::ReceiveView().
+    /// @param opcode The opcode of the frame.
+    /// @param frame The frame, without the trailing newline.
+    /// @param storage The strings for the fields that contain escape sequences, and cannot refer to frame.
+    /// @param correlation_id The correlation ID of the frame.
+    MessageView(Opcode opcode, std::string_view frame, std::array<std::string, 3>* storage, std::uint64_t correlation_id = 0)
+        : opcode(opcode), correlation_id(correlation_id), frame_(frame), storage_(storage) {}
+
+    /// @brief Get data1 of the message.
+    /// @throw InvalidMessageException if the field is missing or invalid.
+    std::string_view Data1() const { return Data(0); }
+
+    /// @brief Get data2 of the message.
+    /// @throw InvalidMessageException if the field is missing or invalid.
+    std::string_view Data2() const { return Data(1); }
+
+    /// @brief Get data3 of the message.
+    /// @throw InvalidMessageException if the field is missing or invalid.
+    std::string_view Data3() const { return Data(2); }
+
+    /// @brief Copy the message, so that it can be kept after the next receive.
+    /// @throw InvalidMessageException if a field is missing or invalid.
+    Message ToMessage() const {
+        Message message(opcode, std::string(Data1()), std::string(Data2()), std::string(Data3()));
+        message.correlation_id = correlation_id;
+        return message;
+    }
+
+   private:
+    std::string_view frame_;
+    std::array<std::string, 3>* storage_ = nullptr;
+    mutable std::array<std::string_view, 3> fields_;
+    mutable bool decoded_ = false;
+
+    std::string_view Data(int index) const {
+        if (decoded_ == false) {
+            Decode();
+        }
+        return fields_[index];
+    }
+
+    void Decode() const;
+};
+
+}  // namespace NetworkFramework
@@ -13,7 +13,13 @@
 
 #include "connect_to_server.h"
 #include "exceptions.h"
+#include "matchmaker.h"
 #include "message.h"
+#include "message_view.h"
+#include "options.h"
+#include "rpc.h"
 #include "server.h"
 #include "service.h"
 #include "socket.h"
+#include "tracing.h"
+#include "typed_message.h"
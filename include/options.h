@@ -0,0 +1,212 @@
+/*
+ *  Description: This file defines the options that can be used to
+ *               configure connections and servers.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace NetworkFramework {
+
+/// @brief The implementation of the system calls of a connection.
+enum class SocketBackend {
+    /// @brief Portable system calls, through the Sockpp library.
+    Sockpp,
+    /// @brief io_uring on Linux 5.6 or newer, with registered receive buffers.
+    /// Sockpp is used instead where it is not available.
+    IoUring,
+};
+
+/// @brief What a connection does with the messages of a peer that exceeds its ReceiveRateLimit.
+enum class RateLimitAction {
+    /// @brief Hold the message in Receive() until the limit allows it. Nothing more is read meanwhile,
+    /// so TCP flow control slows the peer down.
+    Delay,
+    /// @brief Drop the message, i.e. Receive() skips it.
+    Drop,
+    /// @brief Close the connection, i.e. Receive() throws ReceiveLimitExceededException.
+    Disconnect,
+};
+
+/// @brief Token bucket limits on the messages that a connection receives.
+/// The control messages of the framework count toward the byte limit only, except heartbeat pings, which are
+/// answered, and so count as messages too.
+/// Each chunk of a bulk message counts as a message, and if one is dropped, the whole bulk message is.
+struct ReceiveRateLimit {
+    /// @brief The sustained number of messages per second. 0 means unlimited.
+    double messages_per_second = 0;
+
+    /// @brief The number of messages that may arrive at once after a quiet period. 0 means one second worth.
+    double message_burst = 0;
+
+    /// @brief The sustained number of bytes per second on the wire. 0 means unlimited.
+    double bytes_per_second = 0;
+
+    /// @brief The number of bytes that may arrive at once after a quiet period. 0 means one second worth.
+    /// A larger message is let through when the bucket is full, and the following messages pay for it.
+    double byte_burst = 0;
+
+    /// @brief What to do with a message that exceeds the limits.
+    /// When delaying, keep the delays below ConnectionOptions::idle_timeout, which counts them as idle time.
+    RateLimitAction action = RateLimitAction::Delay;
+};
+
+/// @brief Kernel options of the TCP socket of a connection. 0 or false keeps the default of the system.
+/// The options that a platform does not have are ignored.
+struct SocketOptions {
+    /// @brief Send small messages at once, instead of coalescing them with the next ones (TCP_NODELAY).
+    bool no_delay = false;
+
+    /// @brief The size of the send buffer of the kernel, in bytes (SO_SNDBUF).
+    int send_buffer_size = 0;
+
+    /// @brief The size of the receive buffer of the kernel, in bytes (SO_RCVBUF). It also limits the TCP window,
+    /// so it is set before connecting or listening, for the window scale to be negotiated.
+    int receive_buffer_size = 0;
+
+    /// @brief Acknowledge received data at once, instead of delaying the ACK (TCP_QUICKACK, Linux only).
+    /// Linux resets it by itself, so it is set again after every receive, at the cost of a system call.
+    bool quick_ack = false;
+
+    /// @brief Busy poll the device for this many microseconds when a receive would block (SO_BUSY_POLL, Linux only).
+    /// It trades CPU for latency. A value above net.core.busy_read needs CAP_NET_ADMIN.
+    int busy_poll_us = 0;
+};
+
+/// @brief Options that apply to a single connection, on either the server or the client side.
+struct ConnectionOptions {
+    /// @brief The maximum size of a single message on the wire, in bytes, not counting the trailing newline.
+    /// A peer that sends a longer message is disconnected.
+    std::size_t max_message_size = 16 << 20;
+
+    /// @brief The maximum number of received bytes that one connection may buffer,
+    /// including complete messages that have not been consumed by Receive() yet.
+    /// A peer that exceeds it is disconnected.
+    std::size_t max_receive_buffer_size = 32 << 20;
+
+    /// @brief Whether to accept the offer of the peer to delta encode its messages, see Socket::RequestDeltaEncoding().
+    bool accept_delta_encoding = true;
+
+    /// @brief The size in bytes of the pieces of the encoded message that each chunk of Socket::SendBulk() carries.
+    /// A message that is sent with Socket::Send() while a bulk message is being sent waits for at most one chunk.
+    /// Smaller chunks reduce that wait, but cost more frames. 0 sends bulk messages whole.
+    std::size_t bulk_chunk_size = 64 << 10;
+
+    /// @brief The maximum number of bulk messages of the peer that one connection may be receiving at once,
+    /// i.e. whose first chunk has arrived but not their last. A peer that exceeds it is disconnected.
+    std::size_t max_open_bulk_frames = 16;
+
+    /// @brief The implementation of the system calls. On a server, it is used for accepting connections too.
+    SocketBackend backend = SocketBackend::Sockpp;
+
+    /// @brief The most bytes that one receive system call reads. Larger chunks take fewer system calls for large
+    /// or pipelined messages. 0 uses the default of the backend: 1 KiB for Sockpp, and 64 KiB, the size of its
+    /// registered buffer and also the maximum, for io_uring.
+    std::size_t receive_chunk_size = 0;
+
+    /// @brief Close the connection if nothing is received from the peer for this long. 0 disables it.
+    /// Only enforced by Server.
+    std::chrono::milliseconds idle_timeout{0};
+
+    /// @brief Close the connection if a message is not received completely this long after its first byte.
+    /// 0 disables it. Only enforced by Server.
+    std::chrono::milliseconds read_timeout{0};
+
+    /// @brief Send a heartbeat to the peer if nothing is received from it for this long. 0 disables it.
+    /// Only sent by Server. Sockets of this framework answer heartbeats inside Receive(),
+    /// so a client that is waiting in Receive() is not considered idle.
+    /// Other implementations of the protocol do not understand heartbeats, so keep it disabled for them.
+    std::chrono::milliseconds heartbeat_interval{0};
+
+    /// @brief The fraction of sent messages that start a new trace, from 0 (tracing off) to 1, see tracing.h.
+    /// The messages sent while handling a traced message belong to its trace regardless of this option.
+    double trace_sample_rate = 0;
+
+    /// @brief Limits on the rate of the messages received from the peer, e.g. to stop a flooding client
+    /// from taking over the CPU, or the peers that its messages are relayed to.
+    ReceiveRateLimit receive_rate_limit;
+
+    /// @brief The kernel options of the socket. On a server, they are set on the listening socket too.
+    SocketOptions socket;
+};
+
+/// @brief Options of a server.
+struct ServerOptions {
+    /// @brief The options applied to every accepted connection.
+    ConnectionOptions connection;
+
+    /// @brief The maximum number of received bytes that all connections of the server may buffer together.
+    /// A connection that would exceed it is disconnected. 0 means unlimited.
+    std::size_t receive_memory_budget = 0;
+
+    /// @brief The resolution of the timeouts and heartbeats of the connections.
+    std::chrono::milliseconds timer_tick{10};
+
+    /// @brief The number of connections that the kernel queues until they are accepted.
+    /// The system caps it, e.g. at net.core.somaxconn on Linux.
+    int listen_backlog = 128;
+
+    /// @brief Allow listening on the port while connections of a previous server are in TIME_WAIT (SO_REUSEADDR).
+    /// Ignored on Windows, where it would allow taking over a port in use.
+    bool reuse_address = true;
+
+    /// @brief Allow several servers to listen on the same port, which the kernel balances connections between
+    /// (SO_REUSEPORT). Each of them must set it.
+    bool reuse_port = false;
+
+    /// @brief Only accept a connection once its first data arrives, or this long after it is established
+    /// (TCP_DEFER_ACCEPT, Linux only). Use it when the clients speak first. 0 disables it.
+    std::chrono::seconds defer_accept{0};
+
+    /// @brief The number of TCP Fast Open requests that may be pending (TCP_FASTOPEN), so that the first
+    /// message of a returning client comes with its SYN. 0 disables it.
+    /// On Linux, the server side must be enabled by net.ipv4.tcp_fastopen too.
+    int fast_open_queue = 0;
+
+    /// @brief The path of a Unix socket for handing the server over to a new process without closing the port
+    /// (POSIX only). Empty disables it. A server that starts with a path at which another server waits takes over
+    /// its listening socket, so no connection is refused meanwhile. Then it waits at the path for the next one.
+    /// The old server stops accepting, see Server::WaitForHandover(), and serves its connections until they end.
+    /// A file at the path that is not a socket is not replaced, and the server fails to start.
+    std::string handover_path;
+
+    /// @brief Whether the connections are handed over along with the listening socket, with the bytes that were
+    /// received but not consumed. A connection is handed over when its service calls Receive(), which then returns
+    /// std::nullopt in the old process once the new server acknowledges the handover. Until then, Receive() and
+    /// Send() wait, and if the new server fails or hangs, the old one serves the connection again.
+    /// In the new process, the service handles it like a new connection.
+    /// Connections that use delta encoding, or receive a bulk message at the time, stay in the old process.
+    /// Receive() waits for a wake-up along with the socket, which costs a system call per receive.
+    bool hand_over_connections = false;
+
+    /// @brief How long the new server may take to acknowledge the handover, and the connections to reach Receive().
+    std::chrono::milliseconds handover_timeout{1000};
+};
+
+/// @brief Options of a client, see ConnectToServer().
+struct ConnectOptions {
+    /// @brief The options of the connection.
+    ConnectionOptions connection;
+
+    /// @brief The number of attempts to connect.
+    int retry_count = 3;
+
+    /// @brief The time between two attempts.
+    std::chrono::milliseconds retry_interval{1000};
+
+    /// @brief Send the first message with the SYN if the server supports TCP Fast Open
+    /// (TCP_FASTOPEN_CONNECT, Linux 4.11 or newer). The connection is then only established by the first Send(),
+    /// so only use it if the client sends first, and expect an absent server to be reported by Send().
+    bool fast_open = false;
+};
+
+}  // namespace NetworkFramework
@@ -0,0 +1,114 @@
+/*
+ *  Description: This file defines NetworkFramework::RpcClient and
+ *               NetworkFramework::RpcService, a request/response layer
+ *               on top of NetworkFramework::Socket.
+ *
+ *               Every request carries a correlation ID, which its response
+ *               carries back, see Message::correlation_id. So many requests
+ *               may be in flight on one connection, and be answered in any order.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include "message.h"
+#include "service.h"
+#include "socket.h"
+
+namespace NetworkFramework {
+
+class RpcClientImpl;
+class RpcServiceImpl;
+
+/// @brief Sends requests on a connection, without waiting for the responses of the previous ones.
+///
+/// A thread of the client receives the responses. It owns the receiving side of the socket,
+/// so the socket must not be received from by anyone else.
+class RpcClient {
+   public:
+    /// @brief Called with the response to a request, or std::nullopt if the connection is closed before it arrives.
+    /// It is called in the receiving thread of the client, so it should return quickly, and must not throw.
+    typedef std::function<void(std::optional<Message> response)> Callback;
+
+    /// @brief Called with a message of the peer that is not a response, i.e. whose correlation ID is 0.
+    /// It is called in the receiving thread of the client.
+    typedef std::function<void(Message message)> MessageHandler;
+
+    /// @brief Start receiving the responses on a connected socket.
+    /// @param socket The socket, e.g. returned by ConnectToServer().
+    /// @param on_message The handler of the messages that are not responses. They are dropped if it is empty.
+    explicit RpcClient(std::shared_ptr<Socket> socket, MessageHandler on_message = nullptr);
+
+    /// @brief Close the connection, see Close(). If it is called in a callback of the client,
+    /// the receiving thread fails the remaining requests, and frees the client, after the callback returns.
+    ~RpcClient();
+
+    /// @brief Send a request.
+    /// @param request The request. Its correlation ID is set by the client.
+    /// @return The future of the response. It throws BrokenPipeException if the connection is closed before the response arrives.
+    std::future<Message> Call(Message request);
+
+    /// @brief Send a request.
+    /// @param request The request. Its correlation ID is set by the client.
+    /// @param on_response Called with the response. If the connection is already closed, it is called in this thread.
+    void Call(Message request, Callback on_response);
+
+    /// @brief Get the number of requests whose responses have not arrived yet.
+    /// @return The number of requests.
+    std::size_t PendingCount() const;
+
+    /// @brief Close the connection. The requests that are not answered yet fail.
+    void Close();
+
+   private:
+    std::unique_ptr<RpcClientImpl> impl_;
+};
+
+/// @brief Options of an RPC service.
+struct RpcServiceOptions {
+    /// @brief The number of threads that handle requests. 0 means one per hardware thread.
+    std::size_t thread_count = 0;
+
+    /// @brief The maximum number of requests of one connection that are queued or being handled.
+    /// Beyond it, no more requests are received from the connection until one is answered,
+    /// so a client that floods requests is slowed down by TCP flow control.
+    std::size_t max_requests_per_connection = 64;
+};
+
+/// @brief A service that answers the requests of RpcClient.
+///
+/// The requests of all connections are handled by a pool of threads, which take turns between
+/// the connections that have requests, so a connection with many requests does not delay the others.
+/// Several requests of a connection may be handled at once, and the responses are sent as they finish.
+class RpcService : public Service {
+   public:
+    /// @brief Returns the response to a request. It is called by several threads at once, so it must be thread safe.
+    /// If it throws, the connection of the request is closed.
+    typedef std::function<Message(const Message& request)> Handler;
+
+    /// @brief Start the threads of the service.
+    /// @param handler The handler of the requests.
+    /// @param options The options of the service.
+    explicit RpcService(Handler handler, const RpcServiceOptions& options = RpcServiceOptions());
+
+    /// @brief Stop the threads of the service, once the requests that are queued are handled.
+    ~RpcService() override;
+
+    /// @brief Receive the requests of a connection, until the connection is closed and its requests are answered.
+    void Execute(std::shared_ptr<Socket> socket) override;
+
+   private:
+    std::unique_ptr<RpcServiceImpl> impl_;
+};
+
+}  // namespace NetworkFramework
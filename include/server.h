@@ -11,13 +11,30 @@
  */
 
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include "options.h"
 #include "service.h"
 
 namespace NetworkFramework {
 
 class ServerImpl;
 
+/// @brief A snapshot of the memory used by the receive buffers of a server.
+struct ReceiveBufferMetrics {
+    /// @brief The number of bytes currently buffered by all connections.
+    std::size_t bytes_in_use = 0;
+    /// @brief The largest value of bytes_in_use observed so far.
+    std::size_t peak_bytes_in_use = 0;
+    /// @brief The configured ServerOptions::receive_memory_budget, 0 if unlimited.
+    std::size_t budget = 0;
+    /// @brief The number of connections closed because of a per-connection limit.
+    std::uint64_t connection_limit_rejections = 0;
+    /// @brief The number of connections closed because the server-wide budget was exhausted.
+    std::uint64_t budget_rejections = 0;
+};
+
 /// @brief A class that represents a server.
 class Server {
    public:
@@ -26,13 +43,28 @@ class Server {
     /// New connections will be handled by a service object, in a new thread.
     /// @param service A service object which will be used to handle incoming connections.
     /// @param listen_port The port to listen on.
+    /// @param options The options of the server.
     Server(std::shared_ptr<Service> service,
-           int listen_port);
+           int listen_port,
+           const ServerOptions& options = ServerOptions());
     ~Server();
 
     /// @brief Stop listening and close all connections.
     void Shutdown();
 
+    /// @brief Get the memory usage of the receive buffers.
+    /// @return A snapshot of the receive buffer metrics.
+    ReceiveBufferMetrics ReceiveMetrics() const;
+
+    /// @brief Get the number of connections whose service has not returned yet.
+    /// @return The number of connections.
+    std::size_t ConnectionCount() const;
+
+    /// @brief Wait until a new process takes over, see ServerOptions::handover_path, or the server is shut down.
+    /// The connections that were not handed over are still served; ConnectionCount() tells when they end.
+    /// @return true if a new process took over.
+    bool WaitForHandover();
+
    private:
     std::unique_ptr<ServerImpl> impl_;
 };
@@ -18,6 +18,14 @@
 
 namespace NetworkFramework {
 
+/// @brief The reason why a connection timed out.
+enum class TimeoutKind {
+    /// @brief Nothing was received for ConnectionOptions::idle_timeout.
+    Idle,
+    /// @brief A message was not completed within ConnectionOptions::read_timeout.
+    Read,
+};
+
 /// @brief A class that handles a connection.
 /// Only one singleton instance of this class is created for all connections.
 class Service {
@@ -27,6 +35,16 @@ class Service {
     /// @brief Handle a connection.
     /// @param socket The socket of this connection.
     virtual void Execute(std::shared_ptr<Socket> socket) = 0;
+
+    /// @brief Called when a connection times out, right before it is closed.
+    /// Receive() in Execute() returns std::nullopt after the connection is closed.
+    /// It is called in the timer thread of the server, so it should return quickly.
+    /// @param socket The socket of this connection.
+    /// @param kind The reason of the timeout.
+    virtual void OnTimeout(std::shared_ptr<Socket> socket, TimeoutKind kind) {
+        (void)socket;
+        (void)kind;
+    }
 };
 
 }  // namespace NetworkFramework
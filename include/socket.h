@@ -14,6 +14,7 @@
 #include <optional>
 #include "exceptions.h"
 #include "message.h"
+#include "message_view.h"
 
 namespace NetworkFramework {
 
@@ -26,10 +27,36 @@ class Socket {
     /// @param message The message to send.
     virtual void Send(Message message) = 0;
 
+    /// @brief Send a message on the bulk lane, e.g. a game record: a large message is split into chunks,
+    /// see ConnectionOptions::bulk_chunk_size, and the messages sent with Send() meanwhile, from other threads,
+    /// go out between the chunks. The peer reassembles the message, and receives it as a whole.
+    /// Only use it if the peer uses this framework. Sockets that do not support lanes just Send() it.
+    /// @param message The message to send.
+    virtual void SendBulk(Message message) {
+        Send(std::move(message));
+    }
+
     /// @brief Receive a message.
     /// @return The received message, or std::nullopt if the connection was closed.
     virtual std::optional<Message> Receive() = 0;
 
+    /// @brief Receive a message without copying it out of the receive buffer.
+    /// The returned view is valid until the next call of Receive() or ReceiveView(),
+    /// and its data fields are only decoded when they are accessed, so an invalid data
+    /// field is reported by the accessor instead of by this function.
+    /// Sockets that do not override it copy the message from Receive() into storage of the calling thread,
+    /// so their view is only valid until the next call of ReceiveView() on any such socket in the same thread.
+    /// @return The received message, or std::nullopt if the connection was closed.
+    virtual std::optional<MessageView> ReceiveView() {
+        thread_local Message received;
+        auto message = Receive();
+        if (message.has_value() == false) {
+            return std::nullopt;
+        }
+        received = std::move(*message);
+        return MessageView(received);
+    }
+
     /// @brief Close the socket.
     virtual void Close() = 0;
 
@@ -40,6 +67,12 @@ class Socket {
     /// @brief Get the port of the peer.
     /// @return The port of the peer.
     virtual int PeerPort() const = 0;
+
+    /// @brief Offer the peer to receive the messages of this socket delta encoded:
+    /// each data field is sent as edits of the same field of the previous message with the same opcode,
+    /// when that is smaller. It takes effect once Receive() gets the acceptance of the peer.
+    /// Only use it if the peer uses this framework. Sockets that do not support it ignore it.
+    virtual void RequestDeltaEncoding() {}
 };
 
 }  // namespace NetworkFramework
@@ -0,0 +1,63 @@
+/*
+ *  Description: This file defines the tracing of messages through the
+ *               network framework.
+ *
+ *               A sampled message carries a trace ID on the wire, see
+ *               ConnectionOptions::trace_sample_rate. Both sides record spans for it:
+ *                   encode, wait (for the socket), send    on the sending side
+ *                   recv, decode, dispatch                 on the receiving side
+ *               where dispatch lasts from Receive() returning the message to the
+ *               next call of Receive() on that thread, i.e. the logic of the service.
+ *               The messages sent during dispatch belong to the same trace, so a
+ *               request and its reply, or a relayed message, form one trace.
+ *
+ *               The spans are kept per thread, in a fixed number of recent spans,
+ *               and can be exported in the Chrome trace format, which Perfetto opens too.
+ *               The spans of a thread that exits are kept until a new thread reuses
+ *               their memory, so it grows with the threads that run at once, not in total.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+namespace NetworkFramework {
+
+/// @brief Get the trace ID of the message that this thread is dispatching.
+/// @return The trace ID, or 0 if the last message received by this thread is not traced.
+std::uint64_t CurrentTraceId();
+
+/// @brief Records the lifetime of this object as a span of the current trace, e.g. to
+/// break the dispatch span of a service into its steps. Nothing is recorded if the
+/// current message is not traced.
+class TraceSpan {
+   public:
+    /// @param name The name of the span, which must be a string literal or otherwise outlive the trace.
+    explicit TraceSpan(const char* name);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+   private:
+    const char* name_;
+    std::uint64_t trace_id_;
+    std::uint64_t start_;
+};
+
+/// @brief Export the recorded spans of all threads of this process.
+/// Recording continues during the export, so the spans recorded meanwhile may be missing.
+/// @return A JSON document in the Chrome trace format, where the spans of a trace are connected by flow arrows.
+/// The timestamps come from the steady clock, so the traces of processes on the same machine can be merged.
+std::string ExportChromeTrace();
+
+/// @brief Drop the recorded spans, and free the memory of the threads that have exited.
+void ClearTrace();
+
+}  // namespace NetworkFramework
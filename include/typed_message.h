@@ -0,0 +1,332 @@
+/*
+ *  Description: This file defines a header-only layer of typed messages
+ *               on top of NetworkFramework::Message.
+ *
+ *               A typed message is a struct that declares its opcode and its fields:
+ *
+ *                   struct MoveMessage {
+ *                       static constexpr NetworkFramework::Opcode opcode = 3;
+ *                       std::array<int, 2> from;
+ *                       std::array<int, 2> to;
+ *                       std::string comment;
+ *                       using Fields = NetworkFramework::Fields<&MoveMessage::from, &MoveMessage::to, &MoveMessage::comment>;
+ *                   };
+ *
+ *               The code that converts it from and to a Message, and the dispatch
+ *               table of NetworkFramework::MessageRouter, are generated at compile time.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "exceptions.h"
+#include "message.h"
+
+namespace NetworkFramework {
+
+/// @brief The list of fields of a typed message, as pointers to members.
+/// The fields are mapped to data1, data2 and data3 in order, so at most 3 fields are allowed.
+/// A field may be an integer, an enum, a bool, a std::string,
+/// or a std::array of integers, which is encoded as comma-separated numbers.
+template <auto... Members>
+struct Fields {
+    static_assert(sizeof...(Members) <= 3, "A message has only 3 data fields");
+};
+
+namespace TypedMessageDetail {
+
+template <typename T>
+struct IsIntegerArray : std::false_type {};
+
+template <typename T, std::size_t N>
+struct IsIntegerArray<std::array<T, N>> : std::is_integral<T> {};
+
+template <typename T>
+void AppendInteger(std::string& out, T value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+template <typename T>
+bool ParseInteger(std::string_view text, T& value) {
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+template <typename T>
+std::string EncodeField(const T& value) {
+    std::string out;
+    if constexpr (std::is_same_v<T, std::string>) {
+        out = value;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        out = value ? "1" : "0";
+    } else if constexpr (std::is_enum_v<T>) {
+        AppendInteger(out, static_cast<std::underlying_type_t<T>>(value));
+    } else if constexpr (std::is_integral_v<T>) {
+        AppendInteger(out, value);
+    } else if constexpr (IsIntegerArray<T>::value) {
+        for (std::size_t i = 0; i < value.size(); i++) {
+            if (i != 0) {
+                out += ',';
+            }
+            AppendInteger(out, value[i]);
+        }
+    } else {
+        static_assert(sizeof(T) == 0, "Unsupported field type");
+    }
+    return out;
+}
+
+template <typename T>
+bool DecodeField(const std::string& text, T& value) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        value = text;
+        return true;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        value = text == "1";
+        return text == "0" || text == "1";
+    } else if constexpr (std::is_enum_v<T>) {
+        std::underlying_type_t<T> underlying;
+        bool ok = ParseInteger(text, underlying);
+        value = static_cast<T>(underlying);
+        return ok;
+    } else if constexpr (std::is_integral_v<T>) {
+        return ParseInteger(text, value);
+    } else if constexpr (IsIntegerArray<T>::value) {
+        std::string_view rest = text;
+        for (std::size_t i = 0; i < value.size(); i++) {
+            auto comma = i + 1 < value.size() ? rest.find(',') : rest.size();
+            if (comma == std::string_view::npos || ParseInteger(rest.substr(0, comma), value[i]) == false) {
+                return false;
+            }
+            rest.remove_prefix(comma < rest.size() ? comma + 1 : rest.size());
+        }
+        return true;
+    } else {
+        static_assert(sizeof(T) == 0, "Unsupported field type");
+    }
+}
+
+inline std::string& DataField(Message& message, std::size_t index) {
+    return index == 0 ? message.data1 : index == 1 ? message.data2 : message.data3;
+}
+
+inline const std::string& DataField(const Message& message, std::size_t index) {
+    return index == 0 ? message.data1 : index == 1 ? message.data2 : message.data3;
+}
+
+template <typename T, auto... Members, std::size_t... Indices>
+void Encode(const T& value, Message& message, Fields<Members...>, std::index_sequence<Indices...>) {
+    ((DataField(message, Indices) = EncodeField(value.*Members)), ...);
+}
+
+template <typename T, auto... Members, std::size_t... Indices>
+bool Decode(const Message& message, T& value, Fields<Members...>, std::index_sequence<Indices...>) {
+    return (DecodeField(DataField(message, Indices), value.*Members) && ...);
+}
+
+template <typename T>
+struct FieldCount;
+
+template <auto... Members>
+struct FieldCount<Fields<Members...>> : std::integral_constant<std::size_t, sizeof...(Members)> {};
+
+}  // namespace TypedMessageDetail
+
+/// @brief Convert a typed message to a Message.
+/// @param value The typed message.
+/// @return The message with T::opcode, and the fields of value in data1, data2 and data3.
+template <typename T>
+Message ToMessage(const T& value) {
+    using FieldList = typename T::Fields;
+    Message message(T::opcode);
+    TypedMessageDetail::Encode(value, message, FieldList(),
+                               std::make_index_sequence<TypedMessageDetail::FieldCount<FieldList>::value>());
+    return message;
+}
+
+/// @brief Convert a Message to a typed message.
+/// @param message The message, whose opcode must be T::opcode.
+/// @return The typed message.
+/// @throw InvalidMessageException if the opcode or a field does not match T.
+template <typename T>
+T FromMessage(const Message& message) {
+    using FieldList = typename T::Fields;
+    if (message.opcode != T::opcode) {
+        throw InvalidMessageException(std::to_string(message.opcode), "Unexpected opcode");
+    }
+    T value{};
+    if (TypedMessageDetail::Decode(message, value, FieldList(),
+                                   std::make_index_sequence<TypedMessageDetail::FieldCount<FieldList>::value>()) == false) {
+        throw InvalidMessageException(message.data1 + "," + message.data2 + "," + message.data3, "Invalid field");
+    }
+    return value;
+}
+
+/// @brief Dispatches messages to the handlers of their typed messages by opcode.
+///
+/// The opcodes of Types are known at compile time, so the lookup is a jump table
+/// if they are dense, or a binary search over a sorted table otherwise.
+template <typename... Types>
+class MessageRouter {
+   private:
+    static constexpr std::size_t kCount = sizeof...(Types);
+    static_assert(kCount > 0, "At least one message type is required");
+
+    static constexpr std::array<Opcode, kCount> kOpcodes = {Types::opcode...};
+
+    static constexpr bool kUniqueOpcodes = [] {
+        for (std::size_t i = 0; i < kCount; i++) {
+            for (std::size_t j = i + 1; j < kCount; j++) {
+                if (kOpcodes[i] == kOpcodes[j]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }();
+    static_assert(kUniqueOpcodes, "Each message type must have a unique opcode");
+
+    // std::min_element and std::sort are not constexpr in C++17
+    static constexpr Opcode kMinOpcode = [] {
+        Opcode result = kOpcodes[0];
+        for (auto opcode : kOpcodes) {
+            result = opcode < result ? opcode : result;
+        }
+        return result;
+    }();
+    static constexpr Opcode kMaxOpcode = [] {
+        Opcode result = kOpcodes[0];
+        for (auto opcode : kOpcodes) {
+            result = opcode > result ? opcode : result;
+        }
+        return result;
+    }();
+    static constexpr long long kRange = static_cast<long long>(kMaxOpcode) - kMinOpcode + 1;
+    static constexpr bool kDense = kRange <= 256;
+
+    // kJumpTable[opcode - kMinOpcode] is the index of the type plus one, or 0 if none
+    static constexpr auto kJumpTable = [] {
+        std::array<std::size_t, kDense ? kRange : 1> table{};
+        if constexpr (kDense) {
+            for (std::size_t i = 0; i < kCount; i++) {
+                table[kOpcodes[i] - kMinOpcode] = i + 1;
+            }
+        }
+        return table;
+    }();
+
+    struct Entry {
+        Opcode opcode;
+        std::size_t index;
+    };
+
+    // The opcodes and the indexes of their types, sorted by opcode
+    static constexpr auto kSortedTable = [] {
+        std::array<Entry, kCount> table{};
+        for (std::size_t i = 0; i < kCount; i++) {
+            table[i] = Entry{kOpcodes[i], i};
+        }
+        for (std::size_t i = 0; i < kCount; i++) {
+            for (std::size_t j = i + 1; j < kCount; j++) {
+                if (table[j].opcode < table[i].opcode) {
+                    Entry temp = table[i];
+                    table[i] = table[j];
+                    table[j] = temp;
+                }
+            }
+        }
+        return table;
+    }();
+
+    using Handlers = std::tuple<std::function<void(const Types&)>...>;
+    using Thunk = bool (*)(const Handlers&, const Message&);
+
+    template <std::size_t Index>
+    static bool Invoke(const Handlers& handlers, const Message& message) {
+        using T = std::tuple_element_t<Index, std::tuple<Types...>>;
+        auto& handler = std::get<Index>(handlers);
+        if (!handler) {
+            return false;
+        }
+        handler(FromMessage<T>(message));
+        return true;
+    }
+
+    template <std::size_t... Indices>
+    static constexpr std::array<Thunk, kCount> MakeThunks(std::index_sequence<Indices...>) {
+        return {&Invoke<Indices>...};
+    }
+
+    static constexpr std::array<Thunk, kCount> kThunks = MakeThunks(std::make_index_sequence<kCount>());
+
+    template <typename T, std::size_t Index = 0>
+    static constexpr std::size_t IndexOf() {
+        static_assert(Index < kCount, "The type is not routed by this router");
+        if constexpr (std::is_same_v<T, std::tuple_element_t<Index, std::tuple<Types...>>>) {
+            return Index;
+        } else {
+            return IndexOf<T, Index + 1>();
+        }
+    }
+
+    static constexpr std::size_t Find(Opcode opcode) {
+        if constexpr (kDense) {
+            if (opcode < kMinOpcode || opcode > kMaxOpcode) {
+                return kCount;
+            }
+            auto entry = kJumpTable[opcode - kMinOpcode];
+            return entry == 0 ? kCount : entry - 1;
+        } else {
+            std::size_t low = 0, high = kCount;
+            while (low < high) {
+                std::size_t middle = (low + high) / 2;
+                if (kSortedTable[middle].opcode < opcode) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            return low < kCount && kSortedTable[low].opcode == opcode ? kSortedTable[low].index : kCount;
+        }
+    }
+
+    Handlers handlers_;
+
+   public:
+    /// @brief Set the handler of a typed message.
+    /// @param handler The handler, replacing the previous one.
+    template <typename T, typename Handler>
+    void On(Handler&& handler) {
+        std::get<IndexOf<T>()>(handlers_) = std::forward<Handler>(handler);
+    }
+
+    /// @brief Call the handler of the typed message that matches the opcode of message.
+    /// @param message The message to dispatch.
+    /// @return false if the opcode is not routed, or its handler is not set.
+    /// @throw InvalidMessageException if a field of the message does not match its type.
+    bool Dispatch(const Message& message) const {
+        auto index = Find(message.opcode);
+        if (index == kCount) {
+            return false;
+        }
+        return kThunks[index](handlers_, message);
+    }
+};
+
+}  // namespace NetworkFramework
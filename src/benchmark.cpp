@@ -0,0 +1,758 @@
+/*
+ *  Description: This file is a benchmark program for the network framework.
+ *
+ *               Run it without arguments to run all benchmarks,
+ *               or with the names of the benchmarks to run.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#include <stdio.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "delta_codec.h"
+#include "network_framework.h"
+#include "sockpp/tcp_acceptor.h"
+#include "sockpp/tcp_connector.h"
+#include "sockpp_socket.h"
+
+// A socket that is not connected to anything, to measure the framework without the network.
+class NullSocket : public NetworkFramework::Socket {
+   public:
+    void Send(NetworkFramework::Message) override {}
+    std::optional<NetworkFramework::Message> Receive() override { return std::nullopt; }
+    void Close() override {}
+    std::string PeerAddress() const override { return "0.0.0.0"; }
+    int PeerPort() const override { return 0; }
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// A pair of connected sockets over the loopback interface.
+std::pair<std::shared_ptr<NetworkFramework::SockppSocket>, std::shared_ptr<NetworkFramework::SockppSocket>>
+ConnectLoopback(int port, const NetworkFramework::ConnectionOptions& options, int server_receive_buffer_size = 0) {
+    sockpp::initialize();
+    sockpp::error_code error_code;
+    sockpp::tcp_acceptor acceptor((in_port_t)port, 1, error_code);
+    if (error_code) {
+        throw NetworkFramework::BindPortException(port, error_code.message());
+    }
+    auto connector = std::make_unique<sockpp::tcp_connector>();
+    auto address = sockpp::inet_address::create("127.0.0.1", (in_port_t)port);
+    if (connector->connect(address.value()).is_error()) {
+        throw NetworkFramework::ConnectionEstablishmentException("127.0.0.1", port, "connect() failed");
+    }
+    auto accepted = acceptor.accept();
+    if (accepted.is_error()) {
+        throw NetworkFramework::ConnectionEstablishmentException("127.0.0.1", port, "accept() failed");
+    }
+    auto accepted_socket = std::make_unique<sockpp::tcp_socket>(accepted.release());
+    if (server_receive_buffer_size != 0) {
+        accepted_socket->set_option(SOL_SOCKET, SO_RCVBUF, server_receive_buffer_size);
+    }
+    auto client = std::make_shared<NetworkFramework::SockppSocket>(std::move(connector), "127.0.0.1", port, options);
+    auto server = std::make_shared<NetworkFramework::SockppSocket>(std::move(accepted_socket), "127.0.0.1", port, options);
+    return {client, server};
+}
+
+// Many connections over the loopback interface, accepted on one port: the clients, and the servers.
+std::pair<std::vector<std::shared_ptr<NetworkFramework::SockppSocket>>, std::vector<std::shared_ptr<NetworkFramework::SockppSocket>>>
+AcceptLoopback(int port, int count) {
+    sockpp::initialize();
+    sockpp::error_code error_code;
+    sockpp::tcp_acceptor acceptor((in_port_t)port, count, error_code);
+    if (error_code) {
+        throw NetworkFramework::BindPortException(port, error_code.message());
+    }
+    auto address = sockpp::inet_address::create("127.0.0.1", (in_port_t)port);
+    std::pair<std::vector<std::shared_ptr<NetworkFramework::SockppSocket>>, std::vector<std::shared_ptr<NetworkFramework::SockppSocket>>> sockets;
+    for (int i = 0; i < count; i++) {
+        auto connector = std::make_unique<sockpp::tcp_connector>();
+        if (connector->connect(address.value()).is_error()) {
+            throw NetworkFramework::ConnectionEstablishmentException("127.0.0.1", port, "connect() failed");
+        }
+        auto accepted = acceptor.accept();
+        if (accepted.is_error()) {
+            throw NetworkFramework::ConnectionEstablishmentException("127.0.0.1", port, "accept() failed");
+        }
+        auto accepted_socket = std::make_unique<sockpp::tcp_socket>(accepted.release());
+        sockets.first.push_back(std::make_shared<NetworkFramework::SockppSocket>(std::move(connector), "127.0.0.1", port));
+        sockets.second.push_back(std::make_shared<NetworkFramework::SockppSocket>(std::move(accepted_socket), "127.0.0.1", port));
+    }
+    return sockets;
+}
+
+// Pairing throughput of Matchmaker: many threads enqueue players into a few pools at once.
+// With real sockets, the waiting players are watched for a disconnect too.
+void BenchmarkMatchmaker() {
+    const int thread_count = std::max(2u, std::thread::hardware_concurrency());
+    auto connections = AcceptLoopback(7865, 128);
+    for (bool real_sockets : {false, true}) {
+        const int players_per_thread = real_sockets ? 50000 : 200000;
+        std::vector<std::shared_ptr<NetworkFramework::Socket>> players;
+        if (real_sockets) {
+            players.assign(connections.second.begin(), connections.second.end());
+        } else {
+            players.push_back(std::make_shared<NullSocket>());
+        }
+        for (std::size_t players_per_match : {2, 4}) {
+            for (int pool_count : {1, 64, 1024}) {
+                std::atomic<long> matches{0};
+                NetworkFramework::MatchmakerOptions options;
+                options.players_per_match = players_per_match;
+                NetworkFramework::Matchmaker matchmaker(
+                    [&](std::vector<std::shared_ptr<NetworkFramework::Socket>>) { matches.fetch_add(1, std::memory_order_relaxed); },
+                    options);
+                auto start = std::chrono::steady_clock::now();
+                std::vector<std::thread> threads;
+                for (int t = 0; t < thread_count; t++) {
+                    threads.emplace_back([&, t]() {
+                        for (int i = 0; i < players_per_thread; i++) {
+                            matchmaker.Enqueue(players[(t * 31 + i) % players.size()], (t + i) % pool_count);
+                        }
+                    });
+                }
+                for (auto& thread : threads) {
+                    thread.join();
+                }
+                double seconds = SecondsSince(start);
+                printf("matchmaker: %-7s %zu players/match, %4d pools, %2d threads: %8.0f matches/s, %6.1f ns/player\n",
+                       real_sockets ? "sockets" : "null", players_per_match, pool_count, thread_count,
+                       matches / seconds, seconds * 1e9 / (double(players_per_thread) * thread_count));
+            }
+        }
+    }
+}
+
+// The system calls made by the sockets of this thread, if the library counts them, see NETWORK_FRAMEWORK_COUNT_SYSCALLS.
+std::uint64_t SocketSyscalls() {
+#ifdef NETWORK_FRAMEWORK_COUNT_SYSCALLS
+    return NetworkFramework::socket_syscall_count;
+#else
+    return 0;
+#endif
+}
+
+// The system calls per message since SocketSyscalls() returned since, as text, or nothing if they are not counted.
+std::string SyscallsPerMessage(std::uint64_t since, double messages) {
+#ifdef NETWORK_FRAMEWORK_COUNT_SYSCALLS
+    char text[64];
+    snprintf(text, sizeof(text), ", %5.2f syscalls/message", double(SocketSyscalls() - since) / messages);
+    return text;
+#else
+    (void)since;
+    (void)messages;
+    return "";
+#endif
+}
+
+// Round trips and one-way streaming over loopback, with the Sockpp and the io_uring backends.
+// Both read the same chunk size, so that the difference is the backend, and not its default buffer.
+// The system calls are counted by the sockets of the measuring thread only.
+void BenchmarkSocketBackends() {
+    int port = 7870;
+    for (std::size_t chunk_size : {1 << 10, 64 << 10}) {
+        for (auto backend : {NetworkFramework::SocketBackend::Sockpp, NetworkFramework::SocketBackend::IoUring}) {
+            const char* backend_name = backend == NetworkFramework::SocketBackend::Sockpp ? "sockpp  " : "io_uring";
+            for (std::size_t size : {32, 1024, 16384}) {
+                NetworkFramework::ConnectionOptions options;
+                options.backend = backend;
+                options.receive_chunk_size = chunk_size;
+                NetworkFramework::Message message(1, std::string(size, 'x'));
+
+                // Round trips: the peer echoes every message
+                {
+                    auto [client, server] = ConnectLoopback(port++, options);
+                    std::thread echo([server = server]() {
+                        while (auto received = server->Receive()) {
+                            server->Send(received.value());
+                        }
+                    });
+                    constexpr int count = 20000;
+                    auto syscalls = SocketSyscalls();
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < count; i++) {
+                        client->Send(message);
+                        client->Receive();
+                    }
+                    double seconds = SecondsSince(start);
+                    std::string syscalls_per_message = SyscallsPerMessage(syscalls, 2.0 * count);
+                    client->Close();
+                    echo.join();
+                    printf("backend %s, %2zu KiB chunks: round trip, %5zu bytes: %6.2f us/round trip%s\n",
+                           backend_name, chunk_size >> 10, size, seconds * 1e6 / count, syscalls_per_message.c_str());
+                }
+
+                // Streaming: the receiver counts its system calls
+                {
+                    auto [client, server] = ConnectLoopback(port++, options);
+                    constexpr int count = 100000;
+                    std::thread sender([client = client, &message]() {
+                        for (int i = 0; i < count; i++) {
+                            client->Send(message);
+                        }
+                    });
+                    auto syscalls = SocketSyscalls();
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < count; i++) {
+                        server->Receive();
+                    }
+                    double seconds = SecondsSince(start);
+                    std::string syscalls_per_message = SyscallsPerMessage(syscalls, count);
+                    sender.join();
+                    printf("backend %s, %2zu KiB chunks: streaming,  %5zu bytes: %8.0f messages/s%s\n",
+                           backend_name, chunk_size >> 10, size, count / seconds, syscalls_per_message.c_str());
+                }
+            }
+        }
+    }
+}
+
+// A recorded Surakarta game as the server streams it to a client: the 6x6 board after each move,
+// the list of moves so far, and the game metadata.
+std::vector<NetworkFramework::Message> RecordedGame() {
+    std::vector<NetworkFramework::Message> game;
+    std::string board = "BBBBBBBBBBBB............WWWWWWWWWWWW";
+    std::string moves;
+    unsigned seed = 12345;
+    for (int turn = 0; turn < 200; turn++) {
+        char player = turn % 2 ? 'W' : 'B';
+        seed = seed * 1103515245 + 12345;
+        std::size_t from = (seed >> 8) % 36;
+        while (board[from] != player) {
+            from = (from + 1) % 36;
+        }
+        seed = seed * 1103515245 + 12345;
+        std::size_t to = (seed >> 8) % 36;
+        while (board[to] != '.') {
+            to = (to + 1) % 36;
+        }
+        board[to] = player;
+        board[from] = '.';
+        moves += std::to_string(from) + "-" + std::to_string(to) + ";";
+        std::string metadata = "{\"black\":\"alice\",\"white\":\"bob\",\"turn\":" + std::to_string(turn) +
+                               ",\"time_control\":\"10+5\"}";
+        game.emplace_back(1, board, moves, metadata);
+    }
+    return game;
+}
+
+// Bytes on the wire and encode/decode time of a recorded game, with and without delta encoding.
+void BenchmarkDeltaEncoding() {
+    auto game = RecordedGame();
+    for (bool delta : {false, true}) {
+        constexpr int repeat = 200;
+        std::size_t bytes = 0;
+        double encode_seconds = 0, decode_seconds = 0;
+        for (int r = 0; r < repeat; r++) {
+            NetworkFramework::DeltaEncoder encoder;
+            NetworkFramework::DeltaDecoder decoder;
+            std::vector<std::string> frames;
+            auto start = std::chrono::steady_clock::now();
+            for (auto& message : game) {
+                nlohmann::json frame = {{"op", message.opcode}};
+                if (delta) {
+                    encoder.Encode(message, frame);
+                } else {
+                    frame["data1"] = message.data1;
+                    frame["data2"] = message.data2;
+                    frame["data3"] = message.data3;
+                }
+                frames.push_back(frame.dump() + "\n");
+                if (delta) {
+                    encoder.Commit(message);
+                }
+            }
+            encode_seconds += SecondsSince(start);
+            start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < frames.size(); i++) {
+                auto frame = nlohmann::json::parse(frames[i]);
+                NetworkFramework::Message message(frame["op"].get<int>());
+                if (delta) {
+                    decoder.Decode(frame, message, frames[i]);
+                } else {
+                    message.data1 = frame["data1"].get<std::string>();
+                    message.data2 = frame["data2"].get<std::string>();
+                    message.data3 = frame["data3"].get<std::string>();
+                }
+                if ((message == game[i]) == false) {
+                    printf("delta encoding: message %zu is not rebuilt exactly\n", i);
+                    return;
+                }
+            }
+            decode_seconds += SecondsSince(start);
+            for (auto& frame : frames) {
+                bytes += frame.size();
+            }
+        }
+        double messages = double(repeat) * game.size();
+        printf("delta encoding %-3s: %7.1f bytes/message, encode %5.2f us/message, decode %5.2f us/message\n",
+               delta ? "on" : "off", bytes / messages, encode_seconds * 1e6 / messages,
+               decode_seconds * 1e6 / messages);
+    }
+}
+
+// CPU time of the calling thread, which excludes the time spent waiting for the peer.
+double ThreadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit_time, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit_time, &kernel, &user);
+    auto to_seconds = [](const FILETIME& time) {
+        return ((std::uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100e-9;  // In units of 100 ns
+    };
+    return to_seconds(kernel) + to_seconds(user);
+#else
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+#endif
+}
+
+// Receiver CPU time of a service that filters messages by opcode, with Receive() and with ReceiveView().
+void BenchmarkMessageView() {
+    int port = 7800;
+    for (std::size_t size : {64, 4096, 65536}) {
+        for (int mode = 0; mode < 3; mode++) {
+            const char* mode_name[] = {"Receive()            ", "ReceiveView(), opcode", "ReceiveView(), data1 "};
+            auto [client, server] = ConnectLoopback(port++, NetworkFramework::ConnectionOptions());
+            int count = size > 4096 ? 5000 : 50000;
+            NetworkFramework::Message message(1, std::string(size, 'x'), "player", "1");
+            std::thread sender([client = client, &message, count]() {
+                for (int i = 0; i < count; i++) {
+                    message.opcode = i % 4;
+                    client->Send(message);
+                }
+            });
+            std::size_t checksum = 0;
+            double start = ThreadCpuSeconds();
+            for (int i = 0; i < count; i++) {
+                if (mode == 0) {
+                    auto received = server->Receive();
+                    checksum += received->opcode == 0 ? received->data1.size() : 0;
+                } else {
+                    auto received = server->ReceiveView();
+                    checksum += received->opcode == 0 && mode == 2 ? received->Data1().size() : 0;
+                }
+            }
+            double seconds = ThreadCpuSeconds() - start;
+            sender.join();
+            printf("message view: %-21s %6zu bytes: %6.2f us CPU/message (checksum %zu)\n", mode_name[mode], size,
+                   seconds * 1e6 / count, checksum);
+        }
+    }
+}
+
+class BenchmarkEchoService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        try {
+            while (auto message = socket->Receive()) {
+                socket->Send(message.value());
+            }
+        } catch (const NetworkFramework::BrokenPipeException&) {
+        }
+    }
+};
+
+// Round trip latency over loopback with tracing off, sampled, and on for every message.
+void BenchmarkTracing() {
+    int port = 7810;
+    for (double rate : {0.0, 0.01, 1.0}) {
+        NetworkFramework::ConnectionOptions options;
+        options.trace_sample_rate = rate;
+        auto [client, server] = ConnectLoopback(port++, options);
+        std::thread echo([server = server]() {
+            while (auto received = server->Receive()) {
+                server->Send(received.value());
+            }
+        });
+        constexpr int count = 50000;
+        NetworkFramework::Message message(1, std::string(64, 'x'));
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            client->Send(message);
+            client->Receive();
+        }
+        double seconds = SecondsSince(start);
+        client->Close();
+        echo.join();
+        printf("tracing: sample rate %4.2f: %6.2f us/round trip\n", rate, seconds * 1e6 / count);
+    }
+#ifdef __linux__
+    // Memory of a traced server that serves short connections one after another, each on a new thread
+    {
+        NetworkFramework::ServerOptions options;
+        options.connection.trace_sample_rate = 1;
+        NetworkFramework::Server server(std::make_shared<BenchmarkEchoService>(), port, options);
+        auto resident_kib = []() {
+            long pages = 0, resident = 0;
+            if (FILE* file = fopen("/proc/self/statm", "r")) {
+                if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+                    resident = 0;
+                }
+                fclose(file);
+            }
+            return resident * (sysconf(_SC_PAGESIZE) / 1024);
+        };
+        long before = 0;
+        constexpr int connection_count = 1000;
+        for (int i = 0; i <= connection_count; i++) {
+            if (i == 1) {
+                before = resident_kib();  // After the first connection, which creates the buffers of the main thread
+            }
+            auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, 3, options.connection);
+            client->Send(NetworkFramework::Message(1, "traced"));
+            client->Receive();
+            client->Close();
+            while (server.ConnectionCount() != 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        printf("tracing: %d traced connections: resident memory grew by %ld KiB\n", connection_count,
+               resident_kib() - before);
+    }
+#endif
+    auto start = std::chrono::steady_clock::now();
+    auto trace = NetworkFramework::ExportChromeTrace();
+    printf("tracing: exported %zu bytes in %.1f ms\n", trace.size(), SecondsSince(start) * 1e3);
+}
+
+// Round trip latency of a well-behaved client while flooding clients share the server, without and with a rate limit.
+void BenchmarkRateLimit() {
+    int port = 7820;
+    for (bool limited : {false, true}) {
+        NetworkFramework::ServerOptions options;
+        if (limited) {
+            options.connection.receive_rate_limit.messages_per_second = 2000;
+            options.connection.receive_rate_limit.message_burst = 100;
+        }
+        NetworkFramework::Server server(std::make_shared<BenchmarkEchoService>(), port, options);
+        std::atomic<bool> stop{false};
+        std::atomic<long> flooded{0};
+        std::vector<std::thread> threads;
+        std::vector<std::shared_ptr<NetworkFramework::Socket>> flooders;
+        for (int i = 0; i < 4; i++) {
+            std::shared_ptr<NetworkFramework::Socket> flooder = NetworkFramework::ConnectToServer("127.0.0.1", port);
+            flooders.push_back(flooder);
+            threads.emplace_back([flooder, &stop]() {
+                NetworkFramework::Message message(1, std::string(256, 'f'));
+                try {
+                    while (stop == false) {
+                        flooder->Send(message);
+                    }
+                } catch (const NetworkFramework::BrokenPipeException&) {
+                }
+            });
+            threads.emplace_back([flooder, &flooded]() {
+                try {
+                    while (flooder->Receive().has_value()) {
+                        flooded++;
+                    }
+                } catch (const NetworkFramework::BrokenPipeException&) {
+                }
+            });
+        }
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        std::vector<double> latencies;
+        NetworkFramework::Message ping(2, "ping");
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 2000; i++) {
+            auto sent = std::chrono::steady_clock::now();
+            client->Send(ping);
+            client->Receive();
+            latencies.push_back(SecondsSince(sent) * 1e6);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));  // Well below the limit
+        }
+        double seconds = SecondsSince(start);
+        stop = true;
+        for (auto& flooder : flooders) {
+            flooder->Close();
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        client->Close();
+        std::sort(latencies.begin(), latencies.end());
+        printf("rate limit %-3s: well-behaved client p50 %7.1f us, p99 %7.1f us; flooders served %8.0f messages/s\n",
+               limited ? "on" : "off", latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+               flooded / seconds);
+        port++;
+    }
+}
+
+// Latency of small urgent messages while large records are sent on the same connection,
+// with the records sent whole by Send(), and in chunks by SendBulk(). The receive buffer
+// of the receiver is small, so that the records queue at the sender, as on a slow link.
+// The blocked time is how long the sender of an urgent message waits for the records in Send().
+void BenchmarkPriorityLanes() {
+    int port = 7830;
+    for (bool bulk_lane : {false, true}) {
+        auto [client, server] = ConnectLoopback(port++, NetworkFramework::ConnectionOptions(), 64 << 10);
+        std::vector<double> latencies;
+        std::thread receiver([server = server, &latencies]() {
+            while (auto message = server->Receive()) {
+                if (message->opcode == 2) {
+                    auto sent = std::chrono::steady_clock::time_point(
+                        std::chrono::steady_clock::duration(std::stoll(message->data1)));
+                    latencies.push_back(SecondsSince(sent) * 1e6);
+                }
+            }
+        });
+        constexpr int records = 40;
+        constexpr int record_size = 1 << 20;
+        std::atomic<bool> done{false};
+        std::thread sender([client = client, bulk_lane, &done]() {
+            NetworkFramework::Message record(1, std::string(record_size, 'r'));
+            for (int i = 0; i < records; i++) {
+                bulk_lane ? client->SendBulk(record) : client->Send(record);
+            }
+            done = true;
+        });
+        std::vector<double> blocked;
+        auto start = std::chrono::steady_clock::now();
+        while (done == false) {
+            auto now = std::chrono::steady_clock::now();
+            client->Send(NetworkFramework::Message(2, std::to_string(now.time_since_epoch().count())));
+            blocked.push_back(SecondsSince(now) * 1e6);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        double seconds = SecondsSince(start);
+        sender.join();
+        client->Close();
+        receiver.join();
+        std::sort(latencies.begin(), latencies.end());
+        std::sort(blocked.begin(), blocked.end());
+        printf("priority lanes: records by %-10s: urgent blocked p50 %8.1f us, p99 %8.1f us; "
+               "end to end p50 %8.1f us, p99 %8.1f us; records %5.1f MiB/s\n",
+               bulk_lane ? "SendBulk()" : "Send()", blocked[blocked.size() / 2], blocked[blocked.size() * 99 / 100],
+               latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+               records * double(record_size) / (1 << 20) / seconds);
+    }
+}
+
+// Answers each Op2 message, after any number of Op1 messages, like a turn made of several moves.
+class TurnService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        try {
+            while (auto message = socket->Receive()) {
+                if (message->opcode == 2) {
+                    socket->Send(message.value());
+                }
+            }
+        } catch (const NetworkFramework::BrokenPipeException&) {
+        }
+    }
+};
+
+// Connection setup, and turns of two small messages answered by one, with the kernel options of the sockets
+// off and on. With Nagle's algorithm, the second message of a turn waits for the delayed ACK of the first.
+void BenchmarkSocketOptions() {
+    struct Configuration {
+        const char* name;
+        NetworkFramework::ServerOptions server;
+        NetworkFramework::ConnectOptions client;
+    };
+    std::vector<Configuration> configurations(4);
+    configurations[0].name = "defaults";
+    configurations[1].name = "no_delay";
+    configurations[1].server.connection.socket.no_delay = true;
+    configurations[2].name = "no_delay quick_ack busy_poll";
+    configurations[2].server.connection.socket = {true, 0, 0, true, 50};
+    configurations[3].name = "no_delay fast_open defer_accept";
+    configurations[3].server.connection.socket.no_delay = true;
+    configurations[3].server.fast_open_queue = 256;
+    configurations[3].server.defer_accept = std::chrono::seconds(1);
+    configurations[3].client.fast_open = true;
+    int port = 7840;
+    for (auto& configuration : configurations) {
+        configuration.client.connection.socket = configuration.server.connection.socket;
+        NetworkFramework::Server server(std::make_shared<TurnService>(), port, configuration.server);
+
+        // Connection setup: connect, and wait for the answer to the first message
+        constexpr int connections = 500;
+        std::vector<double> setups;
+        for (int i = 0; i < connections; i++) {
+            auto start = std::chrono::steady_clock::now();
+            auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, configuration.client);
+            client->Send(NetworkFramework::Message(2));
+            client->Receive();
+            setups.push_back(SecondsSince(start) * 1e6);
+            client->Close();
+        }
+
+        // Turns on one connection
+        constexpr int turns = 200;
+        std::vector<double> round_trips;
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, configuration.client);
+        for (int i = 0; i < turns; i++) {
+            auto start = std::chrono::steady_clock::now();
+            client->Send(NetworkFramework::Message(1, "move"));
+            client->Send(NetworkFramework::Message(2, "end of turn"));
+            client->Receive();
+            round_trips.push_back(SecondsSince(start) * 1e6);
+        }
+        client->Close();
+        std::sort(setups.begin(), setups.end());
+        std::sort(round_trips.begin(), round_trips.end());
+        printf("socket options: %-31s: setup p50 %7.1f us, p99 %7.1f us; turn p50 %8.1f us, p99 %8.1f us\n",
+               configuration.name, setups[connections / 2], setups[connections * 99 / 100],
+               round_trips[turns / 2], round_trips[turns * 99 / 100]);
+        port++;
+    }
+}
+
+// The longest wait of clients that keep sending turns while the server is replaced, once by shutting it down
+// and starting a new one, which the clients reconnect to, and once by handing it over with its connections.
+void BenchmarkHandover() {
+#ifndef _WIN32
+    using namespace std::chrono_literals;
+    constexpr int client_count = 50;
+    int port = 7850;
+    for (bool handover : {false, true}) {
+        NetworkFramework::ServerOptions options;
+        if (handover) {
+            options.handover_path = "/tmp/network-framework-benchmark-handover.sock";
+            options.hand_over_connections = true;
+        }
+        auto server = std::make_unique<NetworkFramework::Server>(std::make_shared<TurnService>(), port, options);
+        std::atomic<bool> done{false};
+        std::atomic<int> reconnects{0};
+        std::vector<double> longest_waits(client_count);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < client_count; i++) {
+            clients.emplace_back([&, i]() {
+                NetworkFramework::ConnectOptions connect_options;
+                connect_options.retry_count = 10;
+                connect_options.connection.socket.no_delay = true;
+                auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, connect_options);
+                while (done == false) {
+                    auto start = std::chrono::steady_clock::now();
+                    std::optional<NetworkFramework::Message> answer;
+                    try {
+                        client->Send(NetworkFramework::Message(2, "end of turn"));
+                        answer = client->Receive();
+                    } catch (const NetworkFramework::BrokenPipeException&) {
+                    }
+                    if (answer.has_value() == false) {
+                        client = NetworkFramework::ConnectToServer("127.0.0.1", port, connect_options);
+                        reconnects++;
+                    }
+                    longest_waits[i] = std::max(longest_waits[i], SecondsSince(start) * 1e3);
+                    std::this_thread::sleep_for(1ms);
+                }
+                client->Close();
+            });
+        }
+        std::this_thread::sleep_for(200ms);
+        auto start = std::chrono::steady_clock::now();
+        if (handover) {
+            auto new_server = std::make_unique<NetworkFramework::Server>(std::make_shared<TurnService>(), port, options);
+            server->WaitForHandover();
+            server = std::move(new_server);
+        } else {
+            server.reset();
+            server = std::make_unique<NetworkFramework::Server>(std::make_shared<TurnService>(), port, options);
+        }
+        double replace_ms = SecondsSince(start) * 1e3;
+        std::this_thread::sleep_for(3s);
+        done = true;
+        for (auto& client : clients) {
+            client.join();
+        }
+        std::sort(longest_waits.begin(), longest_waits.end());
+        printf("handover: %-9s: replaced in %6.1f ms; %3d reconnects; longest wait of a client p50 %7.1f ms, max %7.1f ms\n",
+               handover ? "handover" : "restart", replace_ms, reconnects.load(),
+               longest_waits[client_count / 2], longest_waits.back());
+        port++;
+    }
+#endif
+}
+
+// Requests per second of one connection to a service whose requests each wait 200 us, e.g. for a database,
+// when the client waits for each response before the next request, and when it keeps several requests in flight.
+void BenchmarkRpc() {
+    using namespace std::chrono_literals;
+    constexpr int request_count = 4000;
+    constexpr int port = 7860;
+    NetworkFramework::ServerOptions options;
+    options.connection.socket.no_delay = true;
+    // The handler mostly waits, so there are more threads than cores
+    auto service = std::make_shared<NetworkFramework::RpcService>(
+        [](const NetworkFramework::Message& request) {
+            std::this_thread::sleep_for(200us);
+            return NetworkFramework::Message(request.opcode, request.data1);
+        },
+        NetworkFramework::RpcServiceOptions{16, 64});
+    NetworkFramework::Server server(service, port, options);
+    NetworkFramework::ConnectOptions connect_options;
+    connect_options.connection = options.connection;
+    for (std::size_t in_flight : {1, 8, 64}) {
+        NetworkFramework::RpcClient client(NetworkFramework::ConnectToServer("127.0.0.1", port, connect_options));
+        std::vector<std::future<NetworkFramework::Message>> responses(in_flight);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < request_count; i++) {
+            auto& response = responses[i % in_flight];
+            if (response.valid()) {
+                response.get();
+            }
+            response = client.Call(NetworkFramework::Message(1, "position"));
+        }
+        for (auto& response : responses) {
+            response.get();
+        }
+        double seconds = SecondsSince(start);
+        printf("rpc: %2zu in flight: %8.0f requests/s\n", in_flight, request_count / seconds);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::pair<std::string, std::function<void()>>> benchmarks = {
+        {"matchmaker", BenchmarkMatchmaker},
+        {"socket-backends", BenchmarkSocketBackends},
+        {"delta-encoding", BenchmarkDeltaEncoding},
+        {"message-view", BenchmarkMessageView},
+        {"tracing", BenchmarkTracing},
+        {"rate-limit", BenchmarkRateLimit},
+        {"priority-lanes", BenchmarkPriorityLanes},
+        {"socket-options", BenchmarkSocketOptions},
+        {"handover", BenchmarkHandover},
+        {"rpc", BenchmarkRpc},
+    };
+    for (auto& [name, benchmark] : benchmarks) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected = selected || name == argv[i];
+        }
+        if (selected) {
+            benchmark();
+        }
+    }
+    return 0;
+}
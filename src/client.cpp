@@ -13,34 +13,48 @@
 #include <thread>
 #include "connect_to_server.h"
 #include "exceptions.h"
-#include "sockpp/tcp_connector.h"
+#include "socket_tuning.h"
 #include "sockpp_socket.h"
 #include "validate_address.h"
 
 std::unique_ptr<NetworkFramework::Socket>
-NetworkFramework::ConnectToServer(const std::string& address_remote, int port_remote, int retry_count) {
+NetworkFramework::ConnectToServer(const std::string& address_remote,
+                                  int port_remote,
+                                  int retry_count,
+                                  const ConnectionOptions& options) {
+    ConnectOptions connect_options;
+    connect_options.connection = options;
+    connect_options.retry_count = retry_count;
+    return ConnectToServer(address_remote, port_remote, connect_options);
+}
+
+std::unique_ptr<NetworkFramework::Socket>
+NetworkFramework::ConnectToServer(const std::string& address_remote,
+                                  int port_remote,
+                                  const ConnectOptions& options) {
     sockpp::initialize();
     try {
         auto addr = ValidateAddress(address_remote, port_remote);
-        auto connector = std::make_unique<sockpp::tcp_connector>();
-        sockpp::result<> result;
+        std::unique_ptr<sockpp::tcp_socket> socket;
+        std::string error;
+        int retry_count = options.retry_count;
         do {
-            result = connector->connect(addr);
+            socket = SocketTuning::Connect(addr, options, error);
             retry_count--;
-            if (result.is_error() && retry_count > 0) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (socket == nullptr && retry_count > 0) {
+                std::this_thread::sleep_for(options.retry_interval);
             }
-        } while (result.is_error() && retry_count > 0);
-        if (result.is_error()) {
+        } while (socket == nullptr && retry_count > 0);
+        if (socket == nullptr) {
             throw ConnectionEstablishmentException(
                 address_remote,
                 port_remote,
-                result.error_message());
+                error);
         }
         auto peer_address_port = addr.to_string();
         auto peer_address = peer_address_port.substr(0, peer_address_port.find(':'));
         auto peer_port = std::stoi(peer_address_port.substr(peer_address_port.find(':') + 1));
-        return std::make_unique<SockppSocket>(std::move(connector), peer_address, peer_port);
+        return std::make_unique<SockppSocket>(std::move(socket), peer_address, peer_port, options.connection);
     } catch (const std::system_error& error) {
         throw ConnectionEstablishmentException(
             address_remote,
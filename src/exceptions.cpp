@@ -102,3 +102,20 @@ int NetworkFramework::BindPortException::Port() const noexcept {
 std::string NetworkFramework::BindPortException::Details() const noexcept {
     return details_;
 }
+
+NetworkFramework::ReceiveLimitExceededException::ReceiveLimitExceededException(const std::string& limit_name, std::size_t limit)
+    : what_("Receive limit exceeded: " + limit_name + ": " + std::to_string(limit)),
+      limit_name_(limit_name),
+      limit_(limit) {}
+
+const char* NetworkFramework::ReceiveLimitExceededException::what() const noexcept {
+    return what_.c_str();
+}
+
+std::string NetworkFramework::ReceiveLimitExceededException::LimitName() const noexcept {
+    return limit_name_;
+}
+
+std::size_t NetworkFramework::ReceiveLimitExceededException::Limit() const noexcept {
+    return limit_;
+}
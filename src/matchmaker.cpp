@@ -0,0 +1,36 @@
+/*
+ *  Description: This file implements NetworkFramework::Matchmaker
+ *               defined in include/matchmaker.h,
+ *               using NetworkFramework::MatchmakerImpl
+ *               defined in src/private-include/matchmaker_impl.h
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#include "matchmaker.h"
+#include "matchmaker_impl.h"
+
+NetworkFramework::Matchmaker::Matchmaker(MatchHandler on_match,
+                                         const MatchmakerOptions& options,
+                                         TimeoutHandler on_timeout) {
+    impl_ = std::make_unique<MatchmakerImpl>(std::move(on_match), options, std::move(on_timeout));
+}
+
+NetworkFramework::Matchmaker::~Matchmaker() = default;
+
+NetworkFramework::Matchmaker::Ticket NetworkFramework::Matchmaker::Enqueue(std::shared_ptr<Socket> player, std::uint64_t pool) {
+    return impl_->Enqueue(std::move(player), pool);
+}
+
+bool NetworkFramework::Matchmaker::Cancel(Ticket ticket) {
+    return impl_->Cancel(ticket);
+}
+
+std::size_t NetworkFramework::Matchmaker::WaitingCount() const {
+    return impl_->WaitingCount();
+}
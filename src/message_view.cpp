@@ -0,0 +1,39 @@
+/*
+ *  Description: This file implements NetworkFramework::MessageView
+ *               defined in include/message_view.h
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#include "message_view.h"
+#include "exceptions.h"
+#include "frame_scanner.h"
+
+void NetworkFramework::MessageView::Decode() const {
+    static const char* names[] = {"data1", "data2", "data3"};
+    std::array<FrameScanner::RawString, 3> raw_fields;
+    if (FrameScanner::ScanDataFields(frame_, raw_fields) == false) {
+        throw InvalidMessageException(std::string(frame_), "Invalid frame");
+    }
+    for (int i = 0; i < 3; i++) {
+        auto& raw = raw_fields[i];
+        if (raw.found == false) {
+            throw InvalidMessageException(std::string(frame_), std::string("Missing or invalid ") + names[i]);
+        }
+        if (raw.escaped == false) {
+            fields_[i] = raw.text;
+            continue;
+        }
+        auto& storage = (*storage_)[i];
+        if (FrameScanner::Unescape(raw.text, storage) == false) {
+            throw InvalidMessageException(std::string(frame_), std::string("Invalid escape sequence in ") + names[i]);
+        }
+        fields_[i] = storage;
+    }
+    decoded_ = true;
+}
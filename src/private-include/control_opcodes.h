@@ -0,0 +1,34 @@
+/*
+ *  Description: This file defines the opcodes that are reserved
+ *               by the network framework for its own messages.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <limits>
+#include "message.h"
+
+namespace NetworkFramework {
+
+// Control messages are handled inside Receive() and never returned to the caller.
+enum ControlOpcode : Opcode {
+    OpControlFirst = std::numeric_limits<Opcode>::min(),
+    OpHeartbeatPing = OpControlFirst,
+    OpHeartbeatPong,
+    OpDeltaOffer,
+    OpDeltaAccept,
+    OpChunk,  // A piece of the text of a bulk frame: data1 is the ID of the frame, data2 the piece, data3 "1" if it is the last
+    OpControlLast = OpControlFirst + 255,
+};
+
+inline bool IsControlOpcode(Opcode opcode) {
+    return opcode <= OpControlLast;
+}
+
+}  // namespace NetworkFramework
@@ -0,0 +1,222 @@
+/*
+ *  Description: This file implements NetworkFramework::DeltaEncoder and
+ *               NetworkFramework::DeltaDecoder, which encode the data fields
+ *               of a message as edits of the fields of the previous message
+ *               with the same opcode.
+ *
+ *               A field N of a delta frame is one of:
+ *                   "dataN": "value"                    the full value
+ *                   "dN": 0                             the previous value
+ *                   "dN": [[pos, len, "text"], ...]     the previous value, with each range
+ *                                                       [pos, pos + len) replaced by text
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <string>
+#include <unordered_map>
+#include "exceptions.h"
+#include "message.h"
+#include "nlohmann/json.hpp"
+
+namespace NetworkFramework {
+
+namespace DeltaCodecDetail {
+
+// Both sides stop adding opcodes to their history at the same point, so they stay in sync
+constexpr std::size_t kMaxOpcodes = 256;
+
+// Changed runs that are separated by fewer equal bytes than this are merged into one edit,
+// since an edit costs about this many bytes of JSON
+constexpr std::size_t kMergeDistance = 8;
+
+typedef std::array<std::string, 3> FieldValues;
+
+inline const char* FullKey(int index) {
+    static const char* keys[] = {"data1", "data2", "data3"};
+    return keys[index];
+}
+
+inline const char* DeltaKey(int index) {
+    static const char* keys[] = {"d1", "d2", "d3"};
+    return keys[index];
+}
+
+inline std::string& Field(Message& message, int index) {
+    return index == 0 ? message.data1 : index == 1 ? message.data2 : message.data3;
+}
+
+inline const std::string& Field(const Message& message, int index) {
+    return index == 0 ? message.data1 : index == 1 ? message.data2 : message.data3;
+}
+
+// Returns true if the byte at position of text continues a UTF-8 character
+inline bool IsContinuation(const std::string& text, std::size_t position) {
+    return position < text.size() && (static_cast<unsigned char>(text[position]) & 0xC0) == 0x80;
+}
+
+// The edits that turn previous into current, and a rough size of their JSON.
+// The text of each edit is made of whole UTF-8 characters of current, which JSON can encode.
+inline nlohmann::json Diff(const std::string& previous, const std::string& current, std::size_t& size) {
+    std::size_t prefix = 0;
+    std::size_t max_common = std::min(previous.size(), current.size());
+    while (prefix < max_common && previous[prefix] == current[prefix]) {
+        prefix++;
+    }
+    while (prefix > 0 && IsContinuation(current, prefix)) {
+        prefix--;
+    }
+    std::size_t suffix = 0;
+    while (suffix < max_common - prefix &&
+           previous[previous.size() - 1 - suffix] == current[current.size() - 1 - suffix]) {
+        suffix++;
+    }
+    while (suffix > 0 && IsContinuation(current, current.size() - suffix)) {
+        suffix--;
+    }
+    nlohmann::json edits = nlohmann::json::array();
+    size = 2;
+    auto add_edit = [&](std::size_t position, std::size_t length, std::string text) {
+        size += text.size() + 16;
+        edits.push_back({position, length, std::move(text)});
+    };
+    if (previous.size() != current.size()) {
+        // Insertions and deletions shift the rest of the string, so use one edit between prefix and suffix
+        add_edit(prefix, previous.size() - prefix - suffix, current.substr(prefix, current.size() - prefix - suffix));
+        return edits;
+    }
+    // Equal lengths, e.g. a board: replace each run of changed bytes
+    std::size_t end = current.size() - suffix;
+    std::size_t position = prefix;
+    while (position < end) {
+        std::size_t run_end = position + 1;
+        std::size_t equal = 0;
+        for (std::size_t i = run_end; i < end && equal < kMergeDistance; i++) {
+            if (previous[i] == current[i]) {
+                equal++;
+            } else {
+                equal = 0;
+                run_end = i + 1;
+            }
+        }
+        while (IsContinuation(current, run_end)) {
+            run_end++;
+        }
+        add_edit(position, run_end - position, current.substr(position, run_end - position));
+        position = run_end;
+        while (position < end && previous[position] == current[position]) {
+            position++;
+        }
+        while (IsContinuation(current, position)) {
+            position--;  // Stops at run_end at the latest, which starts a character
+        }
+    }
+    return edits;
+}
+
+}  // namespace DeltaCodecDetail
+
+class DeltaEncoder {
+   private:
+    std::unordered_map<Opcode, DeltaCodecDetail::FieldValues> history_;
+
+   public:
+    // Add the data fields of message to frame, each as a full value or as edits, whichever is smaller.
+    // The history is not changed until Commit(), so a frame that fails to be serialized leaves it as it was.
+    void Encode(const Message& message, nlohmann::json& frame) const {
+        using namespace DeltaCodecDetail;
+        frame["delta"] = 1;
+        auto found = history_.find(message.opcode);
+        if (found == history_.end()) {
+            for (int i = 0; i < 3; i++) {
+                frame[FullKey(i)] = Field(message, i);
+            }
+            return;
+        }
+        for (int i = 0; i < 3; i++) {
+            const std::string& current = Field(message, i);
+            const std::string& previous = found->second[i];
+            if (current == previous) {
+                frame[DeltaKey(i)] = 0;
+                continue;
+            }
+            std::size_t delta_size;
+            auto edits = Diff(previous, current, delta_size);
+            if (delta_size < current.size()) {
+                frame[DeltaKey(i)] = std::move(edits);
+            } else {
+                frame[FullKey(i)] = current;
+            }
+        }
+    }
+
+    // Remember the data fields of a message whose frame is sent, as DeltaDecoder::Decode() does when it arrives.
+    void Commit(const Message& message) {
+        using namespace DeltaCodecDetail;
+        auto found = history_.find(message.opcode);
+        if (found != history_.end()) {
+            found->second = {message.data1, message.data2, message.data3};
+        } else if (history_.size() < kMaxOpcodes) {
+            history_.emplace(message.opcode, FieldValues{message.data1, message.data2, message.data3});
+        }
+    }
+};
+
+class DeltaDecoder {
+   private:
+    std::unordered_map<Opcode, DeltaCodecDetail::FieldValues> history_;
+
+   public:
+    // Rebuild the data fields of a frame encoded by DeltaEncoder::Encode().
+    // message_str is only used for error messages.
+    void Decode(const nlohmann::json& frame, Message& message, const std::string& message_str) {
+        using namespace DeltaCodecDetail;
+        auto found = history_.find(message.opcode);
+        for (int i = 0; i < 3; i++) {
+            std::string& field = Field(message, i);
+            if (frame.contains(FullKey(i)) && frame[FullKey(i)].is_string()) {
+                field = frame[FullKey(i)].get<std::string>();
+                continue;
+            }
+            if (found == history_.end() || frame.contains(DeltaKey(i)) == false) {
+                throw InvalidMessageException(message_str, std::string("Missing or invalid ") + FullKey(i));
+            }
+            const std::string& previous = found->second[i];
+            const auto& delta = frame[DeltaKey(i)];
+            if (delta.is_array() == false) {
+                field = previous;
+                continue;
+            }
+            std::size_t copied = 0;  // previous[0, copied) has been handled
+            for (const auto& edit : delta) {
+                if (edit.is_array() == false || edit.size() != 3 || edit[0].is_number_unsigned() == false ||
+                    edit[1].is_number_unsigned() == false || edit[2].is_string() == false) {
+                    throw InvalidMessageException(message_str, "Invalid delta");
+                }
+                std::size_t position = edit[0].get<std::size_t>();
+                std::size_t length = edit[1].get<std::size_t>();
+                if (position < copied || position > previous.size() || length > previous.size() - position) {
+                    throw InvalidMessageException(message_str, "Invalid delta");
+                }
+                field.append(previous, copied, position - copied);
+                field += edit[2].get_ref<const std::string&>();
+                copied = position + length;
+            }
+            field.append(previous, copied, std::string::npos);
+        }
+        if (found != history_.end()) {
+            found->second = {message.data1, message.data2, message.data3};
+        } else if (history_.size() < kMaxOpcodes) {
+            history_.emplace(message.opcode, FieldValues{message.data1, message.data2, message.data3});
+        }
+    }
+};
+
+}  // namespace NetworkFramework
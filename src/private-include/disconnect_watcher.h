@@ -0,0 +1,180 @@
+/*
+ *  Description: This file implements NetworkFramework::DisconnectWatcher,
+ *               which reports when the peer of a socket that nobody receives
+ *               from closes the connection, e.g. a player waiting for a match.
+ *
+ *               One thread waits on an epoll instance for a hang-up of any
+ *               watched socket, without reading from them, so the messages that
+ *               the peer sends meanwhile are left to the next Receive().
+ *               Watching and unwatching a socket is one epoll_ctl() each, and
+ *               the watched sockets are spread over independently locked
+ *               stripes, so that callers do not contend with each other.
+ *
+ *               It is only available on Linux.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sockpp_socket.h"
+
+#ifdef __linux__
+#define NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER 1
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace NetworkFramework {
+
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+
+class DisconnectWatcher {
+   public:
+    // Called in the thread of the watcher with the key of a socket whose peer is gone. The socket is no longer watched.
+    typedef std::function<void(std::uint64_t key)> Handler;
+
+   private:
+    static constexpr std::size_t kStripes = 64;
+    static constexpr std::uint64_t kStopKey = ~std::uint64_t(0);  // The key of stop_ in the epoll instance
+
+    struct Stripe {
+        std::mutex mutex;
+        // Duplicates of the handles of the sockets, by key. They are owned by the watcher, so that a handle that
+        // is closed and reused by the owner of the socket is never mistaken for the watched one.
+        std::unordered_map<std::uint64_t, int> handles;
+    };
+
+    Handler on_disconnect_;
+    std::array<Stripe, kStripes> stripes_;
+    int epoll_;
+    int stop_;  // An eventfd, written once to stop the thread
+    std::thread thread_;
+
+   public:
+    explicit DisconnectWatcher(Handler on_disconnect) : on_disconnect_(std::move(on_disconnect)) {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) {
+            throw std::system_error(errno, std::system_category(), "epoll_create1");
+        }
+        stop_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (stop_ < 0) {
+            int error = errno;
+            close(epoll_);
+            throw std::system_error(error, std::system_category(), "eventfd");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = kStopKey;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, stop_, &event);
+        thread_ = std::thread([this]() { Run(); });
+    }
+
+    ~DisconnectWatcher() {
+        std::uint64_t one = 1;
+        [[maybe_unused]] auto written = write(stop_, &one, sizeof(one));
+        thread_.join();
+        for (auto& stripe : stripes_) {
+            for (auto& [key, handle] : stripe.handles) {
+                close(handle);
+            }
+        }
+        close(stop_);
+        close(epoll_);
+    }
+
+    DisconnectWatcher(const DisconnectWatcher&) = delete;
+    DisconnectWatcher& operator=(const DisconnectWatcher&) = delete;
+
+    // Watch a socket under a key other than ~0. Returns false if it cannot be watched,
+    // i.e. it is not a SockppSocket, or it is closed.
+    bool Watch(std::uint64_t key, Socket& socket) {
+        auto sockpp_socket = dynamic_cast<SockppSocket*>(&socket);
+        if (sockpp_socket == nullptr) {
+            return false;
+        }
+        int handle = sockpp_socket->DuplicateHandle();
+        if (handle < 0) {
+            return false;
+        }
+        epoll_event event{};
+        event.events = EPOLLRDHUP;  // Not EPOLLIN, which the messages of the peer would trigger
+        event.data.u64 = key;
+        Stripe& stripe = StripeOf(key);
+        std::lock_guard lk(stripe.mutex);
+        // Under the lock, so that the thread finds the key once the handle is reported
+        if (epoll_ctl(epoll_, EPOLL_CTL_ADD, handle, &event) != 0) {
+            close(handle);
+            return false;
+        }
+        stripe.handles[key] = handle;
+        return true;
+    }
+
+    // Stop watching a socket. Does nothing if it is not watched.
+    void Unwatch(std::uint64_t key) {
+        Release(key);
+    }
+
+   private:
+    Stripe& StripeOf(std::uint64_t key) {
+        static_assert(kStripes == 64, "StripeOf() takes 6 bits");
+        return stripes_[(key * 0x9E3779B97F4A7C15ull) >> 58];  // The top 6 bits of a Fibonacci hash
+    }
+
+    // Returns false if the key is not watched, e.g. it is unwatched meanwhile.
+    bool Release(std::uint64_t key) {
+        Stripe& stripe = StripeOf(key);
+        std::lock_guard lk(stripe.mutex);
+        auto found = stripe.handles.find(key);
+        if (found == stripe.handles.end()) {
+            return false;
+        }
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, found->second, nullptr);
+        close(found->second);
+        stripe.handles.erase(found);
+        return true;
+    }
+
+    void Run() {
+        epoll_event events[64];
+        std::vector<std::uint64_t> gone;
+        while (true) {
+            int count = epoll_wait(epoll_, events, 64, -1);
+            if (count < 0) {
+                continue;  // EINTR
+            }
+            gone.clear();
+            for (int i = 0; i < count; i++) {
+                if (events[i].data.u64 == kStopKey) {
+                    return;
+                }
+                // EPOLLRDHUP, or EPOLLHUP or EPOLLERR, which are always reported
+                if (Release(events[i].data.u64)) {
+                    gone.push_back(events[i].data.u64);
+                }
+            }
+            for (auto key : gone) {
+                on_disconnect_(key);
+            }
+        }
+    }
+};
+
+#endif
+
+}  // namespace NetworkFramework
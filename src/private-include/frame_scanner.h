@@ -0,0 +1,254 @@
+/*
+ *  Description: This file implements the scanning of frames without
+ *               parsing them into JSON values, for NetworkFramework::MessageView.
+ *
+ *               A frame is a JSON object on one line, see SockppSocket::Encode().
+ *               Only the opcode and the data fields are located and checked:
+ *               the rest of the frame is skipped without validating it.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "message.h"
+
+namespace NetworkFramework {
+
+namespace FrameScanner {
+
+// The content of a string member between its quotes
+struct RawString {
+    std::string_view text;
+    bool escaped = false;  // text contains escape sequences
+    bool found = false;
+};
+
+inline bool IsWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline void SkipWhitespace(std::string_view frame, std::size_t& position) {
+    while (position < frame.size() && IsWhitespace(frame[position])) {
+        position++;
+    }
+}
+
+// The keys are sorted when a frame is encoded, so "op" is the last member: {"data1":...,"op":-12}.
+// Returns false if the frame does not end like that, and must be parsed to find its opcode.
+inline bool ScanOpcode(std::string_view frame, Opcode& opcode) {
+    constexpr std::string_view key = "\"op\":";
+    if (frame.size() < key.size() + 3 || frame.front() != '{' || frame.back() != '}') {
+        return false;
+    }
+    std::size_t end = frame.size() - 1;
+    std::size_t begin = end;
+    while (begin > 0 && frame[begin - 1] >= '0' && frame[begin - 1] <= '9') {
+        begin--;
+    }
+    if (begin > 0 && frame[begin - 1] == '-') {
+        begin--;
+    }
+    if (begin < key.size() + 1 || frame.substr(begin - key.size(), key.size()) != key) {
+        return false;
+    }
+    char before = frame[begin - key.size() - 1];
+    if (before != ',' && before != '{') {
+        return false;
+    }
+    auto result = std::from_chars(frame.data() + begin, frame.data() + end, opcode);
+    return result.ec == std::errc() && result.ptr == frame.data() + end;
+}
+
+// The correlation ID is the first member if it is present, since "correlation" sorts before the other keys:
+// {"correlation":7,"data1":...}. Returns 0 if the frame does not begin like that.
+inline std::uint64_t ScanCorrelation(std::string_view frame) {
+    constexpr std::string_view prefix = "{\"correlation\":";
+    if (frame.substr(0, prefix.size()) != prefix) {
+        return 0;
+    }
+    std::uint64_t correlation_id = 0;
+    auto end = frame.data() + frame.size();
+    auto result = std::from_chars(frame.data() + prefix.size(), end, correlation_id);
+    return result.ec == std::errc() && result.ptr != end && *result.ptr == ',' ? correlation_id : 0;
+}
+
+// Scan the string that starts at the quote at position, and move position past its closing quote.
+inline bool ScanString(std::string_view frame, std::size_t& position, RawString& raw) {
+    std::size_t begin = ++position;
+    raw.escaped = false;
+    while (position < frame.size()) {
+        char c = frame[position];
+        if (c == '"') {
+            raw.text = frame.substr(begin, position - begin);
+            position++;
+            return true;
+        }
+        if (c == '\\') {
+            raw.escaped = true;
+            position++;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            return false;
+        }
+        position++;
+    }
+    return false;
+}
+
+// Skip the value of a member that is not used, e.g. the opcode, up to the next ',' or '}' of the frame.
+inline bool SkipValue(std::string_view frame, std::size_t& position) {
+    int depth = 0;
+    RawString ignored;
+    while (position < frame.size()) {
+        char c = frame[position];
+        if (c == '"') {
+            if (ScanString(frame, position, ignored) == false) {
+                return false;
+            }
+            continue;
+        }
+        if ((c == ',' || c == '}' || c == ']') && depth == 0) {
+            return c != ']';
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+        position++;
+    }
+    return false;
+}
+
+// Locate data1, data2 and data3 in a single pass over the frame.
+// Returns false if the frame is not an object of members, or a data field is not a string.
+inline bool ScanDataFields(std::string_view frame, std::array<RawString, 3>& fields) {
+    std::size_t position = 0;
+    SkipWhitespace(frame, position);
+    if (position == frame.size() || frame[position] != '{') {
+        return false;
+    }
+    position++;
+    SkipWhitespace(frame, position);
+    if (position < frame.size() && frame[position] == '}') {
+        return true;
+    }
+    while (position < frame.size()) {
+        RawString key;
+        if (frame[position] != '"' || ScanString(frame, position, key) == false) {
+            return false;
+        }
+        SkipWhitespace(frame, position);
+        if (position == frame.size() || frame[position] != ':') {
+            return false;
+        }
+        position++;
+        SkipWhitespace(frame, position);
+        if (key.escaped == false && key.text.size() == 5 && key.text.substr(0, 4) == "data" &&
+            key.text[4] >= '1' && key.text[4] <= '3') {
+            auto& field = fields[key.text[4] - '1'];
+            if (position == frame.size() || frame[position] != '"' || ScanString(frame, position, field) == false) {
+                return false;
+            }
+            field.found = true;
+        } else if (SkipValue(frame, position) == false) {
+            return false;
+        }
+        SkipWhitespace(frame, position);
+        if (position < frame.size() && frame[position] == ',') {
+            position++;
+            SkipWhitespace(frame, position);
+        } else {
+            return position + 1 == frame.size() && frame[position] == '}';
+        }
+    }
+    return false;
+}
+
+inline void AppendUtf8(std::string& out, unsigned code_point) {
+    if (code_point < 0x80) {
+        out += static_cast<char>(code_point);
+    } else if (code_point < 0x800) {
+        out += static_cast<char>(0xC0 | (code_point >> 6));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point < 0x10000) {
+        out += static_cast<char>(0xE0 | (code_point >> 12));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code_point >> 18));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+inline bool ParseHex4(std::string_view text, std::size_t position, unsigned& value) {
+    if (position + 4 > text.size()) {
+        return false;
+    }
+    auto result = std::from_chars(text.data() + position, text.data() + position + 4, value, 16);
+    return result.ec == std::errc() && result.ptr == text.data() + position + 4;
+}
+
+// Decode the escape sequences of a JSON string.
+inline bool Unescape(std::string_view text, std::string& out) {
+    out.clear();
+    out.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); i++) {
+        if (text[i] != '\\') {
+            out += text[i];
+            continue;
+        }
+        if (++i == text.size()) {
+            return false;
+        }
+        switch (text[i]) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code_point;
+                if (ParseHex4(text, i + 1, code_point) == false) {
+                    return false;
+                }
+                i += 4;
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    // A surrogate pair
+                    unsigned low;
+                    if (i + 2 >= text.size() || text[i + 1] != '\\' || text[i + 2] != 'u' ||
+                        ParseHex4(text, i + 3, low) == false || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    i += 6;
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+                    return false;
+                }
+                AppendUtf8(out, code_point);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace FrameScanner
+
+}  // namespace NetworkFramework
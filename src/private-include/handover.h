@@ -0,0 +1,266 @@
+/*
+ *  Description: This file implements the channel over which a server hands
+ *               its listening socket, and optionally its connections, over to
+ *               a server in a new process, see ServerOptions::handover_path.
+ *
+ *               The channel is a Unix stream socket. The old server sends a
+ *               sequence of records, each a RecordHeader that carries a file
+ *               descriptor with SCM_RIGHTS, followed by the bytes of the record,
+ *               i.e. the received bytes that a connection has not consumed yet.
+ *
+ *               It is only available on POSIX systems.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#ifndef _WIN32
+#define NETWORK_FRAMEWORK_HAS_HANDOVER 1
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace NetworkFramework {
+
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+
+namespace Handover {
+
+enum RecordKind : std::uint32_t {
+    kListener = 1,    // The listening socket, without bytes
+    kConnection = 2,  // A connection, with its unconsumed received bytes
+    kEnd = 3,         // The last record, without a descriptor
+};
+
+struct RecordHeader {
+    std::uint32_t kind;
+    std::uint32_t reserved;
+    std::uint64_t length;  // The number of bytes that follow the header
+};
+
+// A pipe that stays readable from Wake() to Drain(), to wake up every thread that polls it.
+class WakePipe {
+   private:
+    int fds_[2];
+
+   public:
+    WakePipe() {
+        if (pipe(fds_) != 0) {
+            throw std::system_error(errno, std::system_category(), "pipe");
+        }
+        fcntl(fds_[0], F_SETFL, O_NONBLOCK);
+    }
+
+    ~WakePipe() {
+        close(fds_[0]);
+        close(fds_[1]);
+    }
+
+    WakePipe(const WakePipe&) = delete;
+    WakePipe& operator=(const WakePipe&) = delete;
+
+    int Handle() const {
+        return fds_[0];
+    }
+
+    void Wake() {
+        char byte = 1;
+        [[maybe_unused]] auto written = write(fds_[1], &byte, 1);
+    }
+
+    // Let the pollers block again, e.g. until the next handover.
+    void Drain() {
+        char buffer[64];
+        while (read(fds_[0], buffer, sizeof(buffer)) > 0) {
+        }
+    }
+};
+
+inline bool MakeAddress(const std::string& path, sockaddr_un& address) {
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Listen on path, replacing the socket of a previous server there, so that only the user of the process can connect.
+// Returns -1 and sets error if it fails, e.g. if path is a file that is not a socket.
+inline int Listen(const std::string& path, std::string& error) {
+    sockaddr_un address;
+    if (MakeAddress(path, address) == false) {
+        error = "handover path: " + std::string(std::strerror(errno));
+        return -1;
+    }
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0) {
+        if (S_ISSOCK(status.st_mode) == false) {
+            error = "handover path: " + path + " exists and is not a socket";
+            return -1;
+        }
+        unlink(path.c_str());
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = "handover socket: " + std::string(std::strerror(errno));
+        return -1;
+    }
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        error = "handover bind: " + std::string(std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // Nobody can connect before listen(), so the socket is restricted to the user first. Not with umask(),
+    // which would change the permissions of the files that the other threads of the process create meanwhile.
+    if (chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || lstat(path.c_str(), &status) != 0 ||
+        S_ISSOCK(status.st_mode) == false || status.st_uid != geteuid() ||
+        (status.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+        error = "handover path: " + path + " cannot be restricted to the user";
+        close(fd);
+        return -1;
+    }
+    if (listen(fd, 1) != 0) {
+        error = "handover listen: " + std::string(std::strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Connect to the server that listens on path. Returns -1 if there is none.
+inline int Connect(const std::string& path) {
+    sockaddr_un address;
+    if (MakeAddress(path, address) == false) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+inline bool SendAll(int channel, const char* data, std::size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(channel, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= static_cast<std::size_t>(sent);
+    }
+    return true;
+}
+
+inline bool ReceiveAll(int channel, char* data, std::size_t length) {
+    while (length > 0) {
+        ssize_t received = recv(channel, data, length, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        data += received;
+        length -= static_cast<std::size_t>(received);
+    }
+    return true;
+}
+
+// Send a record, with the descriptor fd unless it is -1. Returns false if the new server is gone.
+inline bool SendRecord(int channel, RecordKind kind, int fd, const std::string& bytes) {
+    RecordHeader header{kind, 0, bytes.size()};
+    iovec vector{&header, sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    if (fd >= 0) {
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* rights = CMSG_FIRSTHDR(&message);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(rights), &fd, sizeof(int));
+    }
+    ssize_t sent;
+    do {
+        sent = sendmsg(channel, &message, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    if (sent <= 0) {
+        return false;
+    }
+    // The descriptor went with the first byte, so the rest of the header is sent as it is
+    auto header_bytes = reinterpret_cast<const char*>(&header);
+    return SendAll(channel, header_bytes + sent, sizeof(header) - sent) && SendAll(channel, bytes.data(), bytes.size());
+}
+
+// Receive a record, and the descriptor sent with it into fd, or -1. Returns false if the channel ends.
+inline bool ReceiveRecord(int channel, RecordKind& kind, int& fd, std::string& bytes) {
+    RecordHeader header;
+    iovec vector{&header, sizeof(header)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t received;
+    do {
+        received = recvmsg(channel, &message, 0);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return false;
+    }
+    fd = -1;
+    for (cmsghdr* rights = CMSG_FIRSTHDR(&message); rights != nullptr; rights = CMSG_NXTHDR(&message, rights)) {
+        if (rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&fd, CMSG_DATA(rights), sizeof(int));
+        }
+    }
+    auto header_bytes = reinterpret_cast<char*>(&header);
+    if (ReceiveAll(channel, header_bytes + received, sizeof(header) - received) == false) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    kind = static_cast<RecordKind>(header.kind);
+    bytes.resize(header.length);
+    if (ReceiveAll(channel, bytes.data(), bytes.size()) == false) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    return true;
+}
+
+}  // namespace Handover
+
+#endif
+
+}  // namespace NetworkFramework
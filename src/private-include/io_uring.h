@@ -0,0 +1,241 @@
+/*
+ *  Description: This file implements NetworkFramework::IoUring, a minimal
+ *               io_uring ring for blocking recv, send and accept, using raw
+ *               system calls so that liburing is not required.
+ *
+ *               Each thread has its own ring, see IoUring::ForThisThread().
+ *               On systems without io_uring it returns nullptr, and the
+ *               callers fall back to the Sockpp library.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define NETWORK_FRAMEWORK_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+#endif
+
+namespace NetworkFramework {
+
+#ifdef NETWORK_FRAMEWORK_COUNT_SYSCALLS
+// The system calls made by the sockets of this thread, for the benchmarks. Off unless the build enables it.
+inline thread_local std::uint64_t socket_syscall_count = 0;
+#endif
+
+inline void CountSocketSyscall() {
+#ifdef NETWORK_FRAMEWORK_COUNT_SYSCALLS
+    socket_syscall_count++;
+#endif
+}
+
+#ifdef NETWORK_FRAMEWORK_HAS_IO_URING
+
+class IoUring {
+   public:
+    // The size of the registered buffer that Receive() reads into
+    static constexpr std::size_t kReceiveBufferSize = 64 * 1024;
+
+   private:
+    static constexpr unsigned kEntries = 4;  // A thread has at most one operation in flight
+
+    int ring_fd_ = -1;
+    void* ring_ = MAP_FAILED;
+    std::size_t ring_size_ = 0;
+    io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqes_size_ = 0;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    io_uring_cqe* cqes_;
+    std::unique_ptr<char[]> receive_buffer_;
+
+    IoUring() = default;
+
+   public:
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes_ != MAP_FAILED) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (ring_ != MAP_FAILED) {
+            munmap(ring_, ring_size_);
+        }
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+        }
+    }
+
+    // Returns the ring of this thread, or nullptr if io_uring, or one of the
+    // operations used here, is not supported by the kernel.
+    static IoUring* ForThisThread() {
+        static const bool supported = IoUring::Create() != nullptr;
+        if (supported == false) {
+            return nullptr;
+        }
+        thread_local std::unique_ptr<IoUring> ring = IoUring::Create();
+        return ring.get();
+    }
+
+    // Receive up to size bytes, at most kReceiveBufferSize, into the registered buffer. Returns the number of
+    // bytes received, 0 if the peer closed the connection, or -errno. The data is valid until the next operation
+    // on this thread.
+    long Receive(int fd, const char** data, std::size_t size) {
+        auto sqe = PrepareSqe(IORING_OP_READ_FIXED, fd);
+        sqe->addr = reinterpret_cast<std::uint64_t>(receive_buffer_.get());
+        sqe->len = static_cast<std::uint32_t>(std::min(size, kReceiveBufferSize));
+        sqe->buf_index = 0;
+        sqe->off = static_cast<std::uint64_t>(-1);  // Use the current position, since a socket is not seekable
+        *data = receive_buffer_.get();
+        return SubmitAndWait();
+    }
+
+    // Send all of data. Returns 0, or -errno.
+    long Send(int fd, const char* data, std::size_t size) {
+        while (size > 0) {
+            auto sqe = PrepareSqe(IORING_OP_SEND, fd);
+            sqe->addr = reinterpret_cast<std::uint64_t>(data);
+            sqe->len = static_cast<std::uint32_t>(size);
+            sqe->msg_flags = MSG_NOSIGNAL;
+            long result = SubmitAndWait();
+            if (result < 0) {
+                return result;
+            }
+            data += result;
+            size -= static_cast<std::size_t>(result);
+        }
+        return 0;
+    }
+
+    // Accept a connection. Returns the new file descriptor, or -errno.
+    long Accept(int fd, sockaddr* address, socklen_t* address_length) {
+        auto sqe = PrepareSqe(IORING_OP_ACCEPT, fd);
+        sqe->addr = reinterpret_cast<std::uint64_t>(address);
+        sqe->addr2 = reinterpret_cast<std::uint64_t>(address_length);
+        sqe->accept_flags = SOCK_CLOEXEC;
+        return SubmitAndWait();
+    }
+
+   private:
+    static std::unique_ptr<IoUring> Create() {
+        std::unique_ptr<IoUring> ring(new IoUring());
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring->ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+        if (ring->ring_fd_ < 0 || (params.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+            return nullptr;
+        }
+        // The submission and completion rings share one mapping
+        std::size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        std::size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ring->ring_size_ = sq_size > cq_size ? sq_size : cq_size;
+        ring->ring_ = mmap(nullptr, ring->ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->ring_fd_, IORING_OFF_SQ_RING);
+        if (ring->ring_ == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqes_size_, PROT_READ | PROT_WRITE,
+                                                      MAP_SHARED | MAP_POPULATE, ring->ring_fd_, IORING_OFF_SQES));
+        if (ring->sqes_ == MAP_FAILED) {
+            return nullptr;
+        }
+        char* base = static_cast<char*>(ring->ring_);
+        ring->sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+        ring->sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+        ring->sq_mask_ = reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+        ring->sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+        ring->cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+        ring->cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+        ring->cq_mask_ = reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+        ring->cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+        if (ring->IsSupported({IORING_OP_READ_FIXED, IORING_OP_SEND, IORING_OP_ACCEPT}) == false) {
+            return nullptr;
+        }
+        // Register the receive buffer, so that the kernel does not map it for every receive
+        ring->receive_buffer_ = std::make_unique<char[]>(kReceiveBufferSize);
+        iovec buffer{ring->receive_buffer_.get(), kReceiveBufferSize};
+        if (syscall(__NR_io_uring_register, ring->ring_fd_, IORING_REGISTER_BUFFERS, &buffer, 1) < 0) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    // Kernels before 5.6 do not support probing, nor IORING_OP_SEND, so they fall back as well
+    bool IsSupported(std::initializer_list<int> opcodes) {
+        constexpr unsigned kProbeOps = 64;
+        std::size_t probe_size = sizeof(io_uring_probe) + kProbeOps * sizeof(io_uring_probe_op);
+        auto probe_memory = std::make_unique<char[]>(probe_size);
+        std::memset(probe_memory.get(), 0, probe_size);
+        auto probe = reinterpret_cast<io_uring_probe*>(probe_memory.get());
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PROBE, probe, kProbeOps) < 0) {
+            return false;
+        }
+        for (int opcode : opcodes) {
+            if (opcode > probe->last_op || (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    io_uring_sqe* PrepareSqe(std::uint8_t opcode, int fd) {
+        unsigned tail = *sq_tail_;
+        unsigned index = tail & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sq_array_[index] = index;
+        return sqe;
+    }
+
+    // Submit the prepared entry and wait for its completion with a single system call.
+    long SubmitAndWait() {
+        __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+        unsigned to_submit = 1;
+        while (true) {
+            CountSocketSyscall();
+            long result = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (result >= 0) {
+                to_submit = 0;
+            } else if (errno != EINTR) {
+                return -errno;
+            }
+            unsigned head = *cq_head_;
+            if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+                long completion = cqes_[head & *cq_mask_].res;
+                __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+                return completion;
+            }
+        }
+    }
+};
+
+#endif
+
+}  // namespace NetworkFramework
@@ -0,0 +1,227 @@
+/*
+ *  Description: This file implements NetworkFramework::Matchmaker
+ *               defined in include/matchmaker.h.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "disconnect_watcher.h"
+#include "matchmaker.h"
+#include "timer_thread.h"
+
+namespace NetworkFramework {
+
+class MatchmakerImpl {
+   private:
+    struct Waiting {
+        Matchmaker::Ticket ticket;
+        std::shared_ptr<Socket> player;
+        TimingWheel::TimerId timer;  // 0 if there is no timeout
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, std::list<Waiting>> pools;
+        // The pool and the position of each waiting player, so that canceling is O(1)
+        std::unordered_map<Matchmaker::Ticket, std::pair<std::uint64_t, std::list<Waiting>::iterator>> tickets;
+    };
+
+    Matchmaker::MatchHandler on_match_;
+    Matchmaker::TimeoutHandler on_timeout_;
+    MatchmakerOptions options_;
+    std::vector<Shard> shards_;
+    std::atomic<Matchmaker::Ticket> next_ticket_{1};
+    std::atomic<std::size_t> waiting_count_{0};
+    std::unique_ptr<TimerThread> timers_;  // nullptr if there is no timeout
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+    std::unique_ptr<DisconnectWatcher> watcher_;
+#endif
+
+   public:
+    MatchmakerImpl(Matchmaker::MatchHandler on_match,
+                   const MatchmakerOptions& options,
+                   Matchmaker::TimeoutHandler on_timeout)
+        : on_match_(std::move(on_match)),
+          on_timeout_(std::move(on_timeout)),
+          options_(options),
+          shards_(options.shard_count > 0 ? options.shard_count : 1) {
+        if (options_.players_per_match == 0) {
+            options_.players_per_match = 1;
+        }
+        if (options_.wait_timeout.count() > 0) {
+            timers_ = std::make_unique<TimerThread>(std::chrono::milliseconds(10));
+        }
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+        watcher_ = std::make_unique<DisconnectWatcher>([this](std::uint64_t ticket) { Disconnected(ticket); });
+#endif
+    }
+
+    ~MatchmakerImpl() {
+        // Before the shards are destroyed, since timers and the watcher access them
+        if (timers_) {
+            timers_->Stop();
+        }
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+        watcher_.reset();
+#endif
+        // The players that are still waiting are not served by anyone any more
+        for (auto& shard : shards_) {
+            for (auto& [pool, waiting] : shard.pools) {
+                for (auto& player : waiting) {
+                    player.player->Close();
+                }
+            }
+        }
+    }
+
+    Matchmaker::Ticket Enqueue(std::shared_ptr<Socket> player, std::uint64_t pool) {
+        // The shard is encoded in the ticket, so that Cancel() finds it without a lookup
+        Matchmaker::Ticket ticket = next_ticket_.fetch_add(1) * shards_.size() + ShardIndex(pool);
+        Shard& shard = shards_[ticket % shards_.size()];
+        std::vector<std::shared_ptr<Socket>> players;
+        std::vector<TimingWheel::TimerId> timers;
+        std::vector<Matchmaker::Ticket> tickets;  // Of the waiting players that are matched
+        {
+            std::lock_guard lk(shard.mutex);
+            auto& waiting = shard.pools[pool];
+            if (waiting.size() + 1 >= options_.players_per_match) {
+                players.reserve(options_.players_per_match);
+                while (players.size() + 1 < options_.players_per_match) {
+                    auto& front = waiting.front();
+                    tickets.push_back(front.ticket);
+                    players.push_back(std::move(front.player));
+                    timers.push_back(front.timer);
+                    shard.tickets.erase(front.ticket);
+                    waiting.pop_front();
+                }
+                players.push_back(std::move(player));
+                if (waiting.empty()) {
+                    shard.pools.erase(pool);
+                }
+            } else {
+                TimingWheel::TimerId timer = 0;
+                if (timers_) {
+                    timer = timers_->Schedule(options_.wait_timeout, [this, ticket]() { TimeOut(ticket); });
+                }
+                waiting.push_back(Waiting{ticket, player, timer});
+                shard.tickets.emplace(ticket, std::make_pair(pool, std::prev(waiting.end())));
+            }
+        }
+        // The watcher is called outside the lock of the shard, since it makes system calls
+        if (players.empty()) {
+            waiting_count_.fetch_add(1, std::memory_order_relaxed);
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+            // After the player can be found, so that its disconnect is not missed. If it left the pool meanwhile,
+            // Unwatch() may have come before Watch(), so it is repeated.
+            if (watcher_->Watch(ticket, *player) && IsWaiting(ticket) == false) {
+                watcher_->Unwatch(ticket);
+            }
+#endif
+            return ticket;
+        }
+        for (auto matched : tickets) {
+            Unwatch(matched);
+        }
+        waiting_count_.fetch_sub(players.size() - 1, std::memory_order_relaxed);
+        for (auto timer : timers) {
+            if (timer != 0) {
+                timers_->Cancel(timer);
+            }
+        }
+        on_match_(std::move(players));
+        return ticket;
+    }
+
+    bool Cancel(Matchmaker::Ticket ticket) {
+        auto removed = Remove(ticket);
+        if (removed.has_value() == false) {
+            return false;
+        }
+        Unwatch(ticket);
+        if (removed->timer != 0) {
+            timers_->Cancel(removed->timer);
+        }
+        return true;
+    }
+
+    std::size_t WaitingCount() const {
+        return waiting_count_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    std::size_t ShardIndex(std::uint64_t pool) const {
+        return std::hash<std::uint64_t>()(pool) % shards_.size();
+    }
+
+    // The caller then unwatches the player, outside the lock of the shard, unless the watcher removed it.
+    std::optional<Waiting> Remove(Matchmaker::Ticket ticket) {
+        Shard& shard = shards_[ticket % shards_.size()];
+        std::lock_guard lk(shard.mutex);
+        auto found = shard.tickets.find(ticket);
+        if (found == shard.tickets.end()) {
+            return std::nullopt;
+        }
+        auto [pool, it] = found->second;
+        Waiting waiting = std::move(*it);
+        auto& pool_list = shard.pools[pool];
+        pool_list.erase(it);
+        if (pool_list.empty()) {
+            shard.pools.erase(pool);
+        }
+        shard.tickets.erase(found);
+        waiting_count_.fetch_sub(1, std::memory_order_relaxed);
+        return waiting;
+    }
+
+    bool IsWaiting(Matchmaker::Ticket ticket) {
+        Shard& shard = shards_[ticket % shards_.size()];
+        std::lock_guard lk(shard.mutex);
+        return shard.tickets.count(ticket) > 0;
+    }
+
+    void Unwatch([[maybe_unused]] Matchmaker::Ticket ticket) {
+#ifdef NETWORK_FRAMEWORK_HAS_DISCONNECT_WATCHER
+        watcher_->Unwatch(ticket);
+#endif
+    }
+
+    // Runs in the thread of the watcher, when the peer of a waiting player closes the connection.
+    // The watcher has unwatched the player already.
+    void Disconnected(Matchmaker::Ticket ticket) {
+        auto removed = Remove(ticket);
+        if (removed.has_value() == false) {
+            return;
+        }
+        if (removed->timer != 0) {
+            timers_->Cancel(removed->timer);
+        }
+        removed->player->Close();
+    }
+
+    void TimeOut(Matchmaker::Ticket ticket) {
+        auto removed = Remove(ticket);
+        if (removed.has_value() == false) {
+            return;
+        }
+        Unwatch(ticket);
+        if (on_timeout_) {
+            on_timeout_(std::move(removed->player));
+        }
+    }
+};
+
+}  // namespace NetworkFramework
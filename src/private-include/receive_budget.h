@@ -0,0 +1,76 @@
+/*
+ *  Description: This file implements NetworkFramework::ReceiveBudget,
+ *               which accounts the memory used by the receive buffers
+ *               of all connections of a server.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "server.h"
+
+namespace NetworkFramework {
+
+class ReceiveBudget {
+   private:
+    const std::size_t limit_;
+    std::atomic<std::size_t> bytes_in_use_{0};
+    std::atomic<std::size_t> peak_bytes_in_use_{0};
+    std::atomic<std::uint64_t> connection_limit_rejections_{0};
+    std::atomic<std::uint64_t> budget_rejections_{0};
+
+   public:
+    // limit == 0 means unlimited
+    explicit ReceiveBudget(std::size_t limit)
+        : limit_(limit) {}
+
+    // Reserve bytes before they are appended to a receive buffer.
+    // Returns false, and reserves nothing, if the budget would be exceeded.
+    bool TryAcquire(std::size_t bytes) {
+        std::size_t in_use = bytes_in_use_.load(std::memory_order_relaxed);
+        std::size_t desired;
+        do {
+            desired = in_use + bytes;
+            if (limit_ != 0 && desired > limit_) {
+                budget_rejections_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!bytes_in_use_.compare_exchange_weak(in_use, desired, std::memory_order_relaxed));
+        std::size_t peak = peak_bytes_in_use_.load(std::memory_order_relaxed);
+        while (peak < desired && !peak_bytes_in_use_.compare_exchange_weak(peak, desired, std::memory_order_relaxed)) {
+        }
+        return true;
+    }
+
+    void Release(std::size_t bytes) {
+        bytes_in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    void RecordConnectionLimitRejection() {
+        connection_limit_rejections_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::size_t Limit() const {
+        return limit_;
+    }
+
+    ReceiveBufferMetrics Metrics() const {
+        ReceiveBufferMetrics metrics;
+        metrics.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+        metrics.peak_bytes_in_use = peak_bytes_in_use_.load(std::memory_order_relaxed);
+        metrics.budget = limit_;
+        metrics.connection_limit_rejections = connection_limit_rejections_.load(std::memory_order_relaxed);
+        metrics.budget_rejections = budget_rejections_.load(std::memory_order_relaxed);
+        return metrics;
+    }
+};
+
+}  // namespace NetworkFramework
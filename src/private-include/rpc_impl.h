@@ -0,0 +1,263 @@
+/*
+ *  Description: This file implements NetworkFramework::RpcClient and
+ *               NetworkFramework::RpcService defined in include/rpc.h.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "exceptions.h"
+#include "rpc.h"
+
+namespace NetworkFramework {
+
+class RpcClientImpl {
+   private:
+    std::shared_ptr<Socket> socket_;
+    RpcClient::MessageHandler on_message_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::uint64_t, RpcClient::Callback> pending_;  // By correlation ID
+    bool closed_ = false;  // Set when the receiving thread returns, after which nothing is added to pending_
+    std::atomic<std::uint64_t> next_correlation_id_{1};
+    bool delete_when_received_ = false;  // Only accessed by the receiving thread
+    std::thread receiver_;
+
+   public:
+    RpcClientImpl(std::shared_ptr<Socket> socket, RpcClient::MessageHandler on_message)
+        : socket_(std::move(socket)), on_message_(std::move(on_message)) {
+        receiver_ = std::thread([this]() { ReceiveResponses(); });
+    }
+
+    ~RpcClientImpl() {
+        Close();
+        if (receiver_.joinable()) {  // Not if the receiving thread deletes the client
+            receiver_.join();
+        }
+    }
+
+    void Call(Message request, RpcClient::Callback on_response) {
+        std::uint64_t correlation_id = next_correlation_id_++;
+        request.correlation_id = correlation_id;
+        {
+            std::unique_lock lk(mutex_);
+            if (closed_) {
+                lk.unlock();
+                on_response(std::nullopt);
+                return;
+            }
+            // Added before sending, since the response may arrive before Send() returns
+            pending_.emplace(correlation_id, std::move(on_response));
+        }
+        try {
+            socket_->Send(std::move(request));
+        } catch (const BrokenPipeException&) {
+            if (auto callback = Take(correlation_id)) {
+                callback(std::nullopt);
+            }
+        }
+    }
+
+    std::future<Message> Call(Message request) {
+        auto promise = std::make_shared<std::promise<Message>>();
+        auto future = promise->get_future();
+        Call(std::move(request), [promise](std::optional<Message> response) {
+            if (response.has_value()) {
+                promise->set_value(std::move(response.value()));
+            } else {
+                promise->set_exception(std::make_exception_ptr(
+                    BrokenPipeException("The connection was closed before the response arrived")));
+            }
+        });
+        return future;
+    }
+
+    std::size_t PendingCount() const {
+        std::lock_guard lk(mutex_);
+        return pending_.size();
+    }
+
+    void Close() {
+        socket_->Close();
+    }
+
+    bool InReceiver() const {
+        return std::this_thread::get_id() == receiver_.get_id();
+    }
+
+    // Called in the receiving thread, e.g. by a callback that destroys the client, which cannot join the thread.
+    // The thread deletes the client when it returns instead.
+    void DeleteWhenReceived() {
+        delete_when_received_ = true;
+        Close();
+    }
+
+   private:
+    // Remove the callback of a request. Returns an empty callback if the request is already answered or failed.
+    RpcClient::Callback Take(std::uint64_t correlation_id) {
+        std::lock_guard lk(mutex_);
+        auto found = pending_.find(correlation_id);
+        if (found == pending_.end()) {
+            return nullptr;
+        }
+        auto callback = std::move(found->second);
+        pending_.erase(found);
+        return callback;
+    }
+
+    void ReceiveResponses() {
+        try {
+            while (auto message = socket_->Receive()) {
+                if (message->correlation_id == 0) {
+                    if (on_message_) {
+                        on_message_(std::move(message.value()));
+                    }
+                } else if (auto callback = Take(message->correlation_id)) {
+                    callback(std::move(message));
+                }
+            }
+        } catch (const BaseException&) {
+            // e.g. an invalid message, after which the stream cannot be trusted
+        }
+        socket_->Close();
+        std::unordered_map<std::uint64_t, RpcClient::Callback> pending;
+        {
+            std::lock_guard lk(mutex_);
+            closed_ = true;
+            pending.swap(pending_);
+        }
+        for (auto& [correlation_id, callback] : pending) {
+            callback(std::nullopt);
+        }
+        if (delete_when_received_) {
+            receiver_.detach();
+            delete this;
+        }
+    }
+};
+
+class RpcServiceImpl {
+   private:
+    struct Connection {
+        std::shared_ptr<Socket> socket;
+        std::deque<Message> requests;  // Received, and not taken by a thread yet
+        std::size_t request_count = 0;  // Queued or being handled
+        bool in_turn = false;           // In turns_, which it is while it has queued requests
+        std::condition_variable condition;  // Notified when request_count decreases
+    };
+
+    RpcService::Handler handler_;
+    std::size_t max_requests_per_connection_;
+    std::mutex mutex_;  // Guards the connections too
+    std::condition_variable condition_;  // Notified when turns_ grows, or the service stops
+    // The connections with queued requests. Each thread takes one request of the first one, and moves it to the back.
+    std::deque<std::shared_ptr<Connection>> turns_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+
+   public:
+    RpcServiceImpl(RpcService::Handler handler, const RpcServiceOptions& options)
+        : handler_(std::move(handler)),
+          max_requests_per_connection_(std::max<std::size_t>(options.max_requests_per_connection, 1)) {
+        std::size_t thread_count = options.thread_count;
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (std::size_t i = 0; i < thread_count; i++) {
+            threads_.emplace_back([this]() { Work(); });
+        }
+    }
+
+    ~RpcServiceImpl() {
+        {
+            std::lock_guard lk(mutex_);
+            stopping_ = true;
+        }
+        condition_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void Execute(std::shared_ptr<Socket> socket) {
+        auto connection = std::make_shared<Connection>();
+        connection->socket = socket;
+        std::unique_lock lk(mutex_);
+        try {
+            while (true) {
+                connection->condition.wait(lk, [&] { return connection->request_count < max_requests_per_connection_; });
+                lk.unlock();
+                auto request = socket->Receive();
+                lk.lock();
+                if (request.has_value() == false) {
+                    break;
+                }
+                connection->requests.push_back(std::move(request.value()));
+                connection->request_count++;
+                if (connection->in_turn == false) {
+                    connection->in_turn = true;
+                    turns_.push_back(connection);
+                    condition_.notify_one();
+                }
+            }
+        } catch (const BaseException&) {
+            // e.g. ReceiveLimitExceededException. The requests that are received are still answered.
+            lk.lock();
+        }
+        connection->condition.wait(lk, [&] { return connection->request_count == 0; });
+    }
+
+   private:
+    void Work() {
+        std::unique_lock lk(mutex_);
+        while (true) {
+            condition_.wait(lk, [this] { return stopping_ || turns_.empty() == false; });
+            if (turns_.empty()) {
+                return;
+            }
+            auto connection = std::move(turns_.front());
+            turns_.pop_front();
+            Message request = std::move(connection->requests.front());
+            connection->requests.pop_front();
+            if (connection->requests.empty()) {
+                connection->in_turn = false;
+            } else {
+                turns_.push_back(connection);
+                condition_.notify_one();
+            }
+            lk.unlock();
+            Handle(*connection, request);
+            lk.lock();
+            connection->request_count--;
+            connection->condition.notify_all();
+        }
+    }
+
+    void Handle(Connection& connection, const Message& request) {
+        try {
+            Message response = handler_(request);
+            response.correlation_id = request.correlation_id;
+            connection.socket->Send(std::move(response));
+        } catch (const BrokenPipeException&) {
+            // The connection is closed, so Execute() returns once its requests are handled
+        } catch (...) {
+            connection.socket->Close();
+        }
+    }
+};
+
+}  // namespace NetworkFramework
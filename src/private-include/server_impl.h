@@ -13,12 +13,25 @@
 #pragma once
 
 #pragma once
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "connect_to_server.h"
+#include "handover.h"
+#include "options.h"
+#include "receive_budget.h"
 #include "service.h"
+#include "socket_tuning.h"
 #include "sockpp/tcp_acceptor.h"
 #include "sockpp_socket.h"
+#include "timer_thread.h"
 #include "validate_address.h"
 
 namespace NetworkFramework {
@@ -27,69 +40,424 @@ class ServerImpl {
    private:
     class Daemon {
        public:
-        Daemon(std::unique_ptr<sockpp::tcp_acceptor> acceptor, std::shared_ptr<Service> service)
-            : acceptor_(std::move(acceptor)), service_(service) {}
+        Daemon(std::unique_ptr<sockpp::tcp_acceptor> acceptor,
+               std::shared_ptr<Service> service,
+               const ServerOptions& options,
+               std::shared_ptr<ReceiveBudget> budget,
+               std::shared_ptr<TimerThread> timers)
+            : acceptor_(std::move(acceptor)),
+              service_(service),
+              options_(options.connection),
+              budget_(budget),
+              timers_(timers),
+              handover_timeout_(options.handover_timeout) {
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+            if (options.hand_over_connections) {
+                migration_pipe_ = std::make_shared<Handover::WakePipe>();
+            }
+#endif
+        }
+
+        ~Daemon() {
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+            if (handover_listener_ >= 0) {
+                close(handover_listener_);
+            }
+#endif
+        }
 
         void operator()() {
             while (true) {
-                sockpp::inet_address peer_address;
-                auto result = acceptor_->accept(&peer_address);
-                if (acceptor_->is_open() == false) {
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+                if (WaitForConnection() == false) {
                     break;
                 }
-                if (result.is_error()) {
-                    break;
+#endif
+                sockpp::inet_address peer_address;
+                std::unique_ptr<sockpp::tcp_socket> socket;
+#ifdef NETWORK_FRAMEWORK_HAS_IO_URING
+                IoUring* ring = options_.backend == SocketBackend::IoUring ? IoUring::ForThisThread() : nullptr;
+                if (ring) {
+                    sockaddr_in address{};
+                    socklen_t address_length = sizeof(address);
+                    long fd = ring->Accept(acceptor_->handle(), reinterpret_cast<sockaddr*>(&address), &address_length);
+                    if (acceptor_->is_open() == false || fd < 0) {
+                        break;
+                    }
+                    peer_address = sockpp::inet_address(address);
+                    socket = std::make_unique<sockpp::tcp_socket>(static_cast<sockpp::socket_t>(fd));
+                } else
+#endif
+                {
+                    auto result = acceptor_->accept(&peer_address);
+                    if (acceptor_->is_open() == false) {
+                        break;
+                    }
+                    if (result.is_error()) {
+                        break;
+                    }
+                    socket = std::make_unique<sockpp::tcp_socket>(result.release());
                 }
-                std::string peer_address_port = peer_address.to_string();
-                std::string peer_address_str = peer_address_port.substr(0, peer_address_port.find(':'));
-                int peer_port = std::stoi(peer_address_port.substr(peer_address_port.find(':') + 1));
-                auto wrapped_socket = std::make_shared<SockppSocket>(
-                    std::make_unique<sockpp::tcp_socket>(result.release()), peer_address_str, peer_port);
-                sockets_.push_back(wrapped_socket);
-                auto thread = std::make_unique<std::thread>([this, wrapped_socket]() {
-                    service_->Execute(wrapped_socket);
-                });
-                threads_.push_back(std::move(thread));
+                Serve(std::move(socket), peer_address);
             }
+            std::lock_guard lk(mutex_);
+            accepting_ = false;
+            condition_variable_.notify_all();
         }
 
-        void Shutdown() {
+        void StopAccepting() {
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+            stop_pipe_.Wake();
+#else
             if (acceptor_->is_open()) {
                 acceptor_->shutdown();
                 acceptor_->close();
             }
-            for (auto socket : sockets_) {
-                socket->Close();
+#endif
+        }
+
+        // Close the listening socket once the daemon returns. It stays open in the new process after a handover.
+        void CloseListener() {
+            acceptor_->close();
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+            if (handover_listener_ >= 0) {
+                close(handover_listener_);
+                handover_listener_ = -1;
+                if (handed_over_ == false) {
+                    unlink(handover_path_.c_str());
+                }
+            }
+#endif
+        }
+
+        // Returns true if the daemon returned because a new process took over.
+        bool WaitUntilStopped() {
+            std::unique_lock lk(mutex_);
+            condition_variable_.wait(lk, [this] { return accepting_ == false; });
+            return handed_over_;
+        }
+
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        // Wait for the next server at path to take over. Called before the daemon runs.
+        void ListenForHandover(const std::string& path, int port) {
+            std::string error;
+            handover_listener_ = Handover::Listen(path, error);
+            if (handover_listener_ < 0) {
+                throw BindPortException(port, error);
+            }
+            handover_path_ = path;
+        }
+
+        // Serve a connection that the previous server handed over, with the bytes it received but did not consume.
+        void Adopt(int fd, std::string bytes) {
+            auto socket = std::make_unique<sockpp::tcp_socket>(static_cast<sockpp::socket_t>(fd));
+            sockaddr_in address{};
+            socklen_t address_length = sizeof(address);
+            if (getpeername(fd, reinterpret_cast<sockaddr*>(&address), &address_length) != 0) {
+                return;  // The peer is gone
+            }
+            Serve(std::move(socket), sockpp::inet_address(address), std::move(bytes));
+        }
+#endif
+
+        // Close all connections, and wait until all service threads return.
+        void CloseSessions() {
+            std::unique_lock lk(mutex_);
+            for (auto& [id, session] : sessions_) {
+                session.socket->Close();
             }
-            for (auto& thread : threads_) {
-                thread->join();
+            condition_variable_.wait(lk, [this] { return sessions_.empty(); });
+            for (auto& weak_socket : retained_) {
+                if (auto socket = weak_socket.lock()) {
+                    socket->Close();
+                }
             }
+            retained_.clear();
+        }
+
+        std::size_t SessionCount() {
+            std::lock_guard lk(mutex_);
+            return sessions_.size();
         }
 
        private:
+        void Serve(std::unique_ptr<sockpp::tcp_socket> socket, const sockpp::inet_address& peer_address, std::string bytes = "") {
+            // Errors are ignored, since the same options were set on the listening socket
+            SocketTuning::Apply(socket->handle(), options_.socket);
+            std::string peer_address_port = peer_address.to_string();
+            std::string peer_address_str = peer_address_port.substr(0, peer_address_port.find(':'));
+            int peer_port = std::stoi(peer_address_port.substr(peer_address_port.find(':') + 1));
+            auto wrapped_socket = std::make_shared<SockppSocket>(
+                std::move(socket), peer_address_str, peer_port, options_, budget_);
+            if (wrapped_socket->Preload(std::move(bytes)) == false) {
+                return;
+            }
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+            if (migration_pipe_) {
+                wrapped_socket->EnableHandover(migration_pipe_);
+            }
+#endif
+            StartSession(wrapped_socket);
+        }
+
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        // Wait until a connection can be accepted. Returns false if the daemon stops, or a new process took over.
+        bool WaitForConnection() {
+            while (true) {
+                pollfd fds[3] = {{acceptor_->handle(), POLLIN, 0},
+                                 {stop_pipe_.Handle(), POLLIN, 0},
+                                 {handover_listener_, POLLIN, 0}};  // Ignored if it is -1
+                if (poll(fds, 3, -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return false;
+                }
+                if (fds[1].revents != 0) {
+                    return false;
+                }
+                if (fds[2].revents != 0 && HandOver()) {
+                    return false;
+                }
+                if (fds[0].revents != 0) {
+                    return true;
+                }
+            }
+        }
+
+        // Hand the listening socket, and the connections if enabled, over to the server that connects to
+        // the handover socket. Until it acknowledges the end of the handover, this server keeps serving.
+        // Returns true if it took over.
+        bool HandOver() {
+            int channel = accept(handover_listener_, nullptr, nullptr);
+            if (channel < 0) {
+                return false;
+            }
+            // A new server that hangs must not stop this one from accepting
+            timeval timeout{static_cast<time_t>(handover_timeout_.count() / 1000),
+                            static_cast<suseconds_t>(handover_timeout_.count() % 1000 * 1000)};
+            setsockopt(channel, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            char acknowledgement;
+            bool taken_over = Handover::SendRecord(channel, Handover::kListener, acceptor_->handle(), "") &&
+                              Handover::ReceiveAll(channel, &acknowledgement, 1);
+            std::vector<std::shared_ptr<SockppSocket>> migrated;
+            if (taken_over) {
+                if (migration_pipe_) {
+                    migrated = MigrateSessions(channel);
+                }
+                taken_over = Handover::SendRecord(channel, Handover::kEnd, -1, "") &&
+                             Handover::ReceiveAll(channel, &acknowledgement, 1);
+            }
+            close(channel);
+            // The connections that were sent are served here until now, and again if the new server failed
+            for (auto& socket : migrated) {
+                socket->FinishHandover(taken_over);
+            }
+            std::lock_guard lk(mutex_);
+            handed_over_ = taken_over;
+            return taken_over;
+        }
+
+        // Send the connections that are detached before handover_timeout_ to the new server.
+        // The others, e.g. those that use delta encoding, stay here until they end.
+        // Returns the connections that were requested, for FinishHandover().
+        std::vector<std::shared_ptr<SockppSocket>> MigrateSessions(int channel) {
+            std::vector<std::shared_ptr<SockppSocket>> sockets;
+            {
+                std::lock_guard lk(mutex_);
+                for (auto& [id, session] : sessions_) {
+                    if (session.socket->RequestHandover()) {
+                        sockets.push_back(session.socket);
+                    }
+                }
+            }
+            migration_pipe_->Wake();
+            auto deadline = std::chrono::steady_clock::now() + handover_timeout_;
+            for (auto& socket : sockets) {
+                std::string bytes;
+                int fd = socket->WaitForHandover(deadline, bytes);
+                if (fd >= 0) {
+                    Handover::SendRecord(channel, Handover::kConnection, fd, bytes);
+                    close(fd);
+                }
+            }
+            migration_pipe_->Drain();  // Every connection that was requested is detached or kept now
+            return sockets;
+        }
+#endif
+
+        struct Session {
+            std::shared_ptr<SockppSocket> socket;
+            std::chrono::steady_clock::time_point last_heartbeat;  // Only accessed in the timer thread
+        };
+
+        void StartSession(std::shared_ptr<SockppSocket> socket) {
+            std::uint64_t id;
+            {
+                std::lock_guard lk(mutex_);
+                id = next_session_id_++;
+                sessions_.emplace(id, Session{socket, std::chrono::steady_clock::time_point()});
+            }
+            if (timers_) {
+                timers_->Schedule(std::chrono::steady_clock::duration::zero(), [this, id]() { CheckTimeouts(id); });
+            }
+            // The thread is detached, so that its resources are reclaimed as soon as the service returns
+            std::thread([this, id, socket]() {
+                try {
+                    service_->Execute(socket);
+                } catch (const BaseException&) {
+                    // e.g. ReceiveLimitExceededException thrown to a service that does not handle it.
+                    // Only this connection is affected, so do not let it terminate the server.
+                    socket->Close();
+                }
+                std::lock_guard lk(mutex_);
+                sessions_.erase(id);
+                if (socket.use_count() > 1) {
+                    Retain(socket);
+                }
+                condition_variable_.notify_all();  // Notify while locked, since CloseSessions() may destroy this object
+            }).detach();
+        }
+
+        // Remember a socket that outlives its session, to close it on shutdown. mutex_ must be held.
+        void Retain(const std::shared_ptr<SockppSocket>& socket) {
+            if (retained_.size() >= 2 * retained_pruned_size_ + 64) {
+                retained_.erase(std::remove_if(retained_.begin(), retained_.end(),
+                                               [](const std::weak_ptr<SockppSocket>& weak_socket) { return weak_socket.expired(); }),
+                                retained_.end());
+                retained_pruned_size_ = retained_.size();
+            }
+            retained_.push_back(socket);
+        }
+
+        // Runs in the timer thread. Checks the timeouts of a session, and re-arms its timer.
+        // Receiving only updates timestamps in the socket, so that the timer is not touched for every message.
+        void CheckTimeouts(std::uint64_t id) {
+            std::shared_ptr<SockppSocket> socket;
+            std::chrono::steady_clock::time_point last_heartbeat;
+            {
+                std::lock_guard lk(mutex_);
+                auto found = sessions_.find(id);
+                if (found == sessions_.end()) {
+                    return;
+                }
+                socket = found->second.socket;
+                last_heartbeat = found->second.last_heartbeat;
+            }
+            auto now = std::chrono::steady_clock::now();
+            auto next = std::chrono::steady_clock::time_point::max();
+            auto last_receive = socket->LastReceiveTime();
+            if (options_.idle_timeout.count() > 0) {
+                if (now - last_receive >= options_.idle_timeout) {
+                    TimeOut(socket, TimeoutKind::Idle);
+                    return;
+                }
+                next = std::min(next, last_receive + options_.idle_timeout);
+            }
+            if (options_.read_timeout.count() > 0) {
+                auto message_start = socket->MessageStartTime();
+                if (message_start.has_value() && now - message_start.value() >= options_.read_timeout) {
+                    TimeOut(socket, TimeoutKind::Read);
+                    return;
+                }
+                // A message may start at any time, so check again after read_timeout at the latest
+                next = std::min(next, message_start.value_or(now) + options_.read_timeout);
+            }
+            if (options_.heartbeat_interval.count() > 0) {
+                auto quiet_since = std::max(last_receive, last_heartbeat);
+                if (now - quiet_since >= options_.heartbeat_interval) {
+                    socket->TrySendHeartbeat();
+                    quiet_since = now;
+                    std::lock_guard lk(mutex_);
+                    auto found = sessions_.find(id);
+                    if (found != sessions_.end()) {
+                        found->second.last_heartbeat = now;
+                    }
+                }
+                next = std::min(next, quiet_since + options_.heartbeat_interval);
+            }
+            if (next != std::chrono::steady_clock::time_point::max()) {
+                timers_->Schedule(next - now, [this, id]() { CheckTimeouts(id); });
+            }
+        }
+
+        void TimeOut(std::shared_ptr<SockppSocket> socket, TimeoutKind kind) {
+            try {
+                service_->OnTimeout(socket, kind);
+            } catch (const BaseException&) {
+                // The connection is closed anyway
+            }
+            socket->Close();
+        }
+
         std::unique_ptr<sockpp::tcp_acceptor> acceptor_;
         std::shared_ptr<Service> service_;
-        std::vector<std::shared_ptr<SockppSocket>> sockets_;
-        std::vector<std::unique_ptr<std::thread>> threads_;
+        ConnectionOptions options_;
+        std::shared_ptr<ReceiveBudget> budget_;
+        std::shared_ptr<TimerThread> timers_;  // nullptr if no timeout or heartbeat is enabled
+        std::mutex mutex_;
+        std::condition_variable condition_variable_;
+        std::unordered_map<std::uint64_t, Session> sessions_;
+        // The sockets that the service still holds after Execute() returns, e.g. players waiting in a matchmaker
+        std::vector<std::weak_ptr<SockppSocket>> retained_;
+        std::size_t retained_pruned_size_ = 0;  // The size of retained_ after its last pruning
+        std::uint64_t next_session_id_ = 0;
+        bool accepting_ = true;    // Guarded by mutex_
+        bool handed_over_ = false;  // Guarded by mutex_
+        std::chrono::milliseconds handover_timeout_;
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        Handover::WakePipe stop_pipe_;
+        std::shared_ptr<Handover::WakePipe> migration_pipe_;  // Wakes the connections up to detach them
+        int handover_listener_ = -1;
+        std::string handover_path_;
+#endif
     };
 
    private:
     int port_;
+    std::shared_ptr<ReceiveBudget> budget_;
+    std::shared_ptr<TimerThread> timers_;
     std::shared_ptr<Daemon> daemon_;
     std::unique_ptr<std::thread> daemon_thread_;
 
    public:
     ServerImpl(std::shared_ptr<Service> service,
-               int listen_port)
-        : port_(listen_port) {
+               int listen_port,
+               const ServerOptions& options)
+        : port_(listen_port), budget_(std::make_shared<ReceiveBudget>(options.receive_memory_budget)) {
         sockpp::initialize();
-        sockpp::error_code acceptor_error_code;
         if (listen_port < 0 || listen_port > 65535)
             throw InvalidAddressOrPortException("localhost", listen_port);
-        std::unique_ptr<sockpp::tcp_acceptor> acceptor = std::make_unique<sockpp::tcp_acceptor>((in_port_t)listen_port, 5, acceptor_error_code);
-        if (acceptor_error_code)
-            throw BindPortException(listen_port, acceptor_error_code.message());
-        daemon_ = std::make_unique<Daemon>(std::move(acceptor), service);
+        std::unique_ptr<sockpp::tcp_acceptor> acceptor;
+        std::vector<std::pair<int, std::string>> connections;
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        if (options.handover_path.empty() == false) {
+            acceptor = TakeOver(options.handover_path, listen_port, connections);
+        }
+#endif
+        if (acceptor == nullptr) {
+            std::string acceptor_error;
+            acceptor = SocketTuning::Listen(listen_port, options, acceptor_error);
+            if (acceptor == nullptr)
+                throw BindPortException(listen_port, acceptor_error);
+        }
+        const auto& connection = options.connection;
+        if (connection.idle_timeout.count() > 0 || connection.read_timeout.count() > 0 || connection.heartbeat_interval.count() > 0) {
+            timers_ = std::make_shared<TimerThread>(options.timer_tick);
+        }
+        try {
+            daemon_ = std::make_unique<Daemon>(std::move(acceptor), service, options, budget_, timers_);
+        } catch (const std::system_error& error) {
+            throw BindPortException(listen_port, error.what());
+        }
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        if (options.handover_path.empty() == false) {
+            daemon_->ListenForHandover(options.handover_path, listen_port);
+        }
+        for (auto& [fd, bytes] : connections) {
+            daemon_->Adopt(fd, std::move(bytes));
+        }
+#endif
         auto daemon_ptr_copy = daemon_;
         daemon_thread_ = std::make_unique<std::thread>([daemon_ptr_copy]() {
             (*daemon_ptr_copy)();
@@ -102,15 +470,80 @@ class ServerImpl {
 
     void Shutdown() {
         if (daemon_thread_ && daemon_thread_->joinable()) {
-            daemon_->Shutdown();
+            daemon_->StopAccepting();
+#ifndef NETWORK_FRAMEWORK_HAS_HANDOVER
             try {
-                auto temp_client = ConnectToServer("localhost", port_);  // Connect to server to unblock acceptor_->accept()
+                auto temp_client = ConnectToServer("localhost", port_, 1);  // Connect to server to unblock acceptor_->accept()
             } catch (...) {
                 // Ignore the exception
             }
+#endif
             daemon_thread_->join();
+            daemon_->CloseListener();
+            daemon_->CloseSessions();
+            if (timers_) {
+                timers_->Stop();
+            }
+        }
+    }
+
+    ReceiveBufferMetrics ReceiveMetrics() const {
+        return budget_->Metrics();
+    }
+
+    std::size_t ConnectionCount() const {
+        return daemon_->SessionCount();
+    }
+
+    bool WaitForHandover() {
+        return daemon_->WaitUntilStopped();
+    }
+
+   private:
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+    // Receive the listening socket, and the connections, from the server that waits for a handover at path.
+    // Returns nullptr if there is none.
+    static std::unique_ptr<sockpp::tcp_acceptor> TakeOver(const std::string& path,
+                                                          int port,
+                                                          std::vector<std::pair<int, std::string>>& connections) {
+        int channel = Handover::Connect(path);
+        if (channel < 0) {
+            return nullptr;
+        }
+        std::unique_ptr<sockpp::tcp_acceptor> acceptor;
+        Handover::RecordKind kind;
+        int fd;
+        std::string bytes;
+        bool complete = false;
+        while (complete == false && Handover::ReceiveRecord(channel, kind, fd, bytes)) {
+            if (kind == Handover::kListener && fd >= 0 && !acceptor) {
+                acceptor = std::make_unique<sockpp::tcp_acceptor>();
+                acceptor->reset(static_cast<sockpp::socket_t>(fd));
+                sockaddr_in address{};
+                socklen_t address_length = sizeof(address);
+                if (getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_length) != 0 ||
+                    ntohs(address.sin_port) != port) {
+                    break;  // The previous server keeps serving
+                }
+                Handover::SendAll(channel, "1", 1);
+            } else if (kind == Handover::kConnection && fd >= 0) {
+                connections.emplace_back(fd, std::move(bytes));
+            } else if (kind == Handover::kEnd) {
+                complete = Handover::SendAll(channel, "1", 1);
+            } else if (fd >= 0) {
+                close(fd);
+            }
+        }
+        close(channel);
+        if (complete == false) {
+            for (auto& connection : connections) {
+                close(connection.first);
+            }
+            throw BindPortException(port, "The server at " + path + " did not hand the port over");
         }
+        return acceptor;
     }
+#endif
 };
 
 }  // namespace NetworkFramework
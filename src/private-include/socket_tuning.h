@@ -0,0 +1,169 @@
+/*
+ *  Description: This file implements the creation of the listening and the
+ *               connecting sockets with the kernel options of ServerOptions,
+ *               ConnectOptions and SocketOptions, and setting SocketOptions on
+ *               the accepted sockets.
+ *
+ *               Some options must be set between socket() and bind(), listen()
+ *               or connect(), so the sockets are created with system calls and
+ *               then handed over to the Sockpp library.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include "options.h"
+#include "sockpp/inet_address.h"
+#include "sockpp/tcp_acceptor.h"
+#include "sockpp/tcp_socket.h"
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
+namespace NetworkFramework {
+
+namespace SocketTuning {
+
+inline std::string LastError() {
+#ifdef _WIN32
+    return std::system_category().message(WSAGetLastError());
+#else
+    return std::strerror(errno);
+#endif
+}
+
+template <typename T>
+inline bool SetOption(sockpp::socket_t handle, int level, int name, T value) {
+    return ::setsockopt(handle, level, name, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+}
+
+// Set the options that differ from the defaults of the system.
+// Returns an error message, or an empty string if all of them are set.
+inline std::string Apply(sockpp::socket_t handle, const SocketOptions& options) {
+    auto failed = [](const char* name) { return std::string(name) + ": " + LastError(); };
+    if (options.no_delay && SetOption(handle, IPPROTO_TCP, TCP_NODELAY, 1) == false) {
+        return failed("TCP_NODELAY");
+    }
+    if (options.send_buffer_size > 0 && SetOption(handle, SOL_SOCKET, SO_SNDBUF, options.send_buffer_size) == false) {
+        return failed("SO_SNDBUF");
+    }
+    if (options.receive_buffer_size > 0 &&
+        SetOption(handle, SOL_SOCKET, SO_RCVBUF, options.receive_buffer_size) == false) {
+        return failed("SO_RCVBUF");
+    }
+#ifdef TCP_QUICKACK
+    if (options.quick_ack && SetOption(handle, IPPROTO_TCP, TCP_QUICKACK, 1) == false) {
+        return failed("TCP_QUICKACK");
+    }
+#endif
+#ifdef SO_BUSY_POLL
+    if (options.busy_poll_us > 0 && SetOption(handle, SOL_SOCKET, SO_BUSY_POLL, options.busy_poll_us) == false) {
+        return failed("SO_BUSY_POLL");
+    }
+#endif
+    return std::string();
+}
+
+// Linux leaves quick ACK mode by itself, so it is entered again after every receive.
+inline void RearmQuickAck([[maybe_unused]] sockpp::socket_t handle) {
+#ifdef TCP_QUICKACK
+    SetOption(handle, IPPROTO_TCP, TCP_QUICKACK, 1);
+#endif
+}
+
+// Create the listening socket of a server on all IPv4 addresses.
+// Returns nullptr and sets error if it fails.
+inline std::unique_ptr<sockpp::tcp_acceptor> Listen(int port, const ServerOptions& options, std::string& error) {
+    auto acceptor = std::make_unique<sockpp::tcp_acceptor>();
+    acceptor->reset(::socket(AF_INET, SOCK_STREAM, 0));
+    auto failed = [&](const char* name) {
+        error = std::string(name) + ": " + LastError();
+        return nullptr;
+    };
+    if (acceptor->is_open() == false) {
+        return failed("socket");
+    }
+    auto handle = acceptor->handle();
+#ifndef _WIN32
+    if (options.reuse_address && SetOption(handle, SOL_SOCKET, SO_REUSEADDR, 1) == false) {
+        return failed("SO_REUSEADDR");
+    }
+#endif
+#ifdef SO_REUSEPORT
+    if (options.reuse_port && SetOption(handle, SOL_SOCKET, SO_REUSEPORT, 1) == false) {
+        return failed("SO_REUSEPORT");
+    }
+#endif
+    // The accepted sockets inherit the buffer sizes, which must be known before the handshake
+    error = Apply(handle, options.connection.socket);
+    if (error.empty() == false) {
+        return nullptr;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<in_port_t>(port));
+    if (::bind(handle, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        return failed("bind");
+    }
+#ifdef TCP_DEFER_ACCEPT
+    if (options.defer_accept.count() > 0 &&
+        SetOption(handle, IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(options.defer_accept.count())) == false) {
+        return failed("TCP_DEFER_ACCEPT");
+    }
+#endif
+#ifdef TCP_FASTOPEN
+    if (options.fast_open_queue > 0 && SetOption(handle, IPPROTO_TCP, TCP_FASTOPEN, options.fast_open_queue) == false) {
+        return failed("TCP_FASTOPEN");
+    }
+#endif
+    if (::listen(handle, options.listen_backlog) != 0) {
+        return failed("listen");
+    }
+    return acceptor;
+}
+
+// Connect a new socket to address. Returns nullptr and sets error if it fails.
+inline std::unique_ptr<sockpp::tcp_socket> Connect(const sockpp::inet_address& address,
+                                                   const ConnectOptions& options,
+                                                   std::string& error) {
+    auto socket = std::make_unique<sockpp::tcp_socket>();
+    socket->reset(::socket(AF_INET, SOCK_STREAM, 0));
+    auto failed = [&](const char* name) {
+        error = std::string(name) + ": " + LastError();
+        return nullptr;
+    };
+    if (socket->is_open() == false) {
+        return failed("socket");
+    }
+    auto handle = socket->handle();
+    error = Apply(handle, options.connection.socket);
+    if (error.empty() == false) {
+        return nullptr;
+    }
+#ifdef TCP_FASTOPEN_CONNECT
+    if (options.fast_open && SetOption(handle, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1) == false) {
+        return failed("TCP_FASTOPEN_CONNECT");
+    }
+#endif
+    if (::connect(handle, address.sockaddr_ptr(), address.size()) != 0) {
+        return failed("connect");
+    }
+    return socket;
+}
+
+}  // namespace SocketTuning
+
+}  // namespace NetworkFramework
@@ -12,10 +12,37 @@
 
 #pragma once
 #include <stdio.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <mutex>
 #include <streambuf>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "control_opcodes.h"
+#include "delta_codec.h"
 #include "exceptions.h"
+#include "frame_scanner.h"
+#include "handover.h"
+#include "io_uring.h"
 #include "nlohmann/json.hpp"
+#include "options.h"
+#include "receive_budget.h"
+#include "socket_tuning.h"
+#include "token_bucket.h"
+#include "trace_recorder.h"
 #include "sockpp/inet_address.h"
 
 namespace NetworkFramework {
@@ -27,55 +54,655 @@ class SockppSocket final : public Socket {
     std::unique_ptr<sockpp::socket> socket_read;
     std::unique_ptr<sockpp::socket> socket_write;
     std::string received_string;
+    std::size_t received_offset = 0;  // received_string[0, received_offset) is consumed, and dropped before the next recv
+    std::size_t scanned_length = 0;   // received_string[received_offset, scanned_length) contains no newline
     std::mutex mutex_read;
     std::mutex mutex_write;
+    std::condition_variable condition_write;  // Notified when no thread in Send() waits for mutex_write
+    std::atomic<int> priority_senders{0};     // The threads in Send() that wait for mutex_write, which SendBulk() lets go first
+    std::atomic<std::uint64_t> next_bulk_id{0};
+    std::atomic<bool> bulk_low_watermark_set{false};
+    std::mutex mutex_close;
+    std::condition_variable condition_close;  // Notified by Close()
+    bool closed = false;
+    ConnectionOptions options;
+    std::shared_ptr<ReceiveBudget> budget;  // may be nullptr
+    std::unique_ptr<RateLimiter> rate_limiter;  // nullptr if the rate is unlimited
+    std::atomic<bool> delta_encoding{false};     // Set when the peer accepts our offer
+    DeltaEncoder delta_encoder;                  // Guarded by mutex_write
+    std::unique_ptr<DeltaDecoder> delta_decoder;  // Created when we accept the offer of the peer
+    Message view_message;                         // The message of the last view that is not borrowed from the frame
+    std::array<std::string, 3> view_storage;      // The unescaped fields of the last view
+    struct PartialFrame {
+        std::string text;      // The chunks received so far
+        bool dropped = false;  // A chunk was dropped by the rate limit, so the rest of the frame is discarded
+    };
+    // The bulk frames being received, by ID. A frame costs the memory budget its text, its ID and this much more.
+    static constexpr std::size_t kPartialFrameOverhead = 128;
+    std::unordered_map<std::string, PartialFrame> partial_frames;
+    static constexpr std::size_t kDefaultReceiveChunkSize = 1024;  // Of the Sockpp backend, see ConnectionOptions
+    std::size_t partial_frames_size = 0;  // The cost of partial_frames
+    std::string reassembled_frame;  // The last bulk frame that was completed
+    // The trace of the last frame, and when it was received, for TraceReceived()
+    std::uint64_t frame_trace_id = 0;
+    std::uint64_t frame_sent_time = 0;  // By the clock of the peer
+    std::chrono::steady_clock::rep frame_receive_start = 0;
+    std::chrono::steady_clock::rep frame_receive_end = 0;
+    // The handover of the connection to a new process, see ServerOptions::handover_path
+    // kDetached: waiting for the new process to acknowledge the handover. kKept: stays here for this handover.
+    enum HandoverState { kServing, kRequested, kDetached, kKept, kHandedOver };
+    std::atomic<int> handover_state{kServing};  // Changed under mutex_close, and notified by condition_close
+    std::string handover_bytes;                 // The received bytes that were not consumed, once detached
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+    std::shared_ptr<Handover::WakePipe> handover_wake;  // nullptr unless the connection may be handed over
+#endif
+    // steady_clock time points, read by the timer thread of the server
+    std::atomic<std::chrono::steady_clock::rep> last_receive_time;
+    std::atomic<std::chrono::steady_clock::rep> message_start_time{0};  // 0 if no message is partially received
 
    public:
-    SockppSocket(std::unique_ptr<sockpp::socket> socket, std::string peer_address, int peer_port)
+    SockppSocket(std::unique_ptr<sockpp::socket> socket,
+                 std::string peer_address,
+                 int peer_port,
+                 const ConnectionOptions& options = ConnectionOptions(),
+                 std::shared_ptr<ReceiveBudget> budget = nullptr)
         : peer_address(peer_address),
           peer_port(peer_port),
           socket_read(std::make_unique<sockpp::socket>(socket->clone())),
-          socket_write(std::make_unique<sockpp::socket>(socket->clone())) {}
+          socket_write(std::make_unique<sockpp::socket>(socket->clone())),
+          options(options),
+          budget(budget),
+          last_receive_time(std::chrono::steady_clock::now().time_since_epoch().count()) {
+        auto limiter = std::make_unique<RateLimiter>(options.receive_rate_limit);
+        if (limiter->Unlimited() == false) {
+            rate_limiter = std::move(limiter);
+        }
+    }
 
     ~SockppSocket() override {
         Close();
+        if (budget) {
+            budget->Release(received_string.size() - received_offset + partial_frames_size);
+        }
     }
 
     void Send(Message message) override {
         // Send the message to the server
-        std::lock_guard lk(mutex_write);
+        std::uint64_t trace_id = TraceIdToSend(message.opcode);
+        TraceRecorder::Timer timer(trace_id, message.opcode);
+        std::string message_str;
+        std::unique_lock lk(mutex_write, std::defer_lock);
+        if (delta_encoding && IsControlOpcode(message.opcode) == false) {
+            // The history of the encoder must be updated in the order in which the frames are sent
+            LockAheadOfBulk(lk);
+            timer.Span("wait");
+            message_str = Encode(message, &delta_encoder, trace_id);
+            timer.Span("encode");
+        } else {
+            message_str = Encode(message, nullptr, trace_id);
+            timer.Span("encode");
+            LockAheadOfBulk(lk);
+            timer.Span("wait");
+        }
+        Write(message_str);
+        timer.Span("send");
+    }
+
+    void SendBulk(Message message) override {
+        if (IsControlOpcode(message.opcode)) {
+            Send(std::move(message));
+            return;
+        }
+        std::uint64_t trace_id = TraceIdToSend(message.opcode);
+        TraceRecorder::Timer timer(trace_id, message.opcode);
+        // Not delta encoded, since the frames encoded after it may overtake its chunks
+        std::string message_str = Encode(message, nullptr, trace_id);
+        timer.Span("encode");
+        std::size_t chunk_size = options.bulk_chunk_size;
+        if (chunk_size == 0 || message_str.size() <= chunk_size) {
+            WriteBulk(message_str);
+            timer.Span("send");
+            return;
+        }
+        std::string id = std::to_string(next_bulk_id++);
+        std::string_view text(message_str.data(), message_str.size() - 1);  // Without the newline
+        std::size_t offset = 0;
+        while (offset < text.size()) {
+            std::size_t end = std::min(offset + chunk_size, text.size());
+            while (end > offset + 1 && end < text.size() && (static_cast<unsigned char>(text[end]) & 0xC0) == 0x80) {
+                end--;  // Do not split a UTF-8 character, which the chunk could not encode
+            }
+            bool last = end == text.size();
+            WriteBulk(Encode(Message(OpChunk, id, std::string(text.substr(offset, end - offset)), last ? "1" : "0")));
+            offset = end;
+        }
+        timer.Span("send");
+    }
+
+    std::optional<Message> Receive() override {
+        TraceRecorder::EndDispatch();
+        while (true) {
+            auto frame = NextFrame();
+            if (frame.has_value() == false) {
+                return std::nullopt;
+            }
+            std::size_t size;
+            auto message = DecodeFrame(frame.value(), size);
+            if (message.has_value() && HandleControl(message.value(), size) == false) {
+                if (size != 0 && Admit(size) == false) {
+                    continue;
+                }
+                TraceReceived(message->opcode);
+                return message;
+            }
+        }
+    }
+
+    std::optional<MessageView> ReceiveView() override {
+        TraceRecorder::EndDispatch();
+        while (true) {
+            auto frame = NextFrame();
+            if (frame.has_value() == false) {
+                return std::nullopt;
+            }
+            // A delta frame depends on the previous ones, so it is decoded when it is received.
+            // So is a traced frame, whose trace follows the opcode.
+            Opcode opcode;
+            if (!delta_decoder && FrameScanner::ScanOpcode(frame.value(), opcode) && IsControlOpcode(opcode) == false) {
+                if (Admit(frame->size() + 1) == false) {
+                    continue;
+                }
+                return MessageView(opcode, frame.value(), &view_storage, FrameScanner::ScanCorrelation(frame.value()));
+            }
+            std::size_t size;
+            auto message = DecodeFrame(frame.value(), size);
+            if (message.has_value() == false) {
+                continue;
+            }
+            view_message = std::move(message.value());
+            if (HandleControl(view_message, size) == false) {
+                if (size != 0 && Admit(size) == false) {
+                    continue;
+                }
+                TraceReceived(view_message.opcode);
+                return MessageView(view_message);
+            }
+        }
+    }
+
+    void Close() override {
+        // Close the connection. It may be called by several threads, e.g. by the timer thread of the server.
+        std::lock_guard lk(mutex_close);
+        if (closed) {
+            return;
+        }
+        closed = true;
+        condition_close.notify_all();
+        if (handover_state == kDetached) {
+            return;  // FinishHandover() closes it, once it knows whether the new process keeps it open
+        }
+        CloseHandles(handover_state != kHandedOver);  // A connection that is handed over stays open in the new process
+    }
+
+    std::string PeerAddress() const override {
+        return peer_address;
+    }
+
+    int PeerPort() const override {
+        return peer_port;
+    }
+
+    void RequestDeltaEncoding() override {
+        Send(Message(OpDeltaOffer));
+    }
+
+    // Send a heartbeat without blocking the caller, which is the timer thread of the server.
+    // Skipped if another thread is sending, since the peer is then not idle anyway.
+    void TrySendHeartbeat() {
+        std::unique_lock lk(mutex_write, std::try_to_lock);
+        if (lk.owns_lock() == false || socket_write->is_open() == false || handover_state == kHandedOver) {
+            return;
+        }
+        std::string message_str = Encode(Message(OpHeartbeatPing));
+#ifdef MSG_DONTWAIT
+        auto result = socket_write->send(message_str.data(), message_str.size(), MSG_DONTWAIT);
+        if (result.is_ok() && result.value() < message_str.size()) {
+            // Rare: the send buffer is almost full. Finish the frame, so that the stream stays valid.
+            socket_write->send(message_str.substr(result.value()));
+        }
+#else
+        socket_write->send(message_str);
+#endif
+    }
+
+    std::chrono::steady_clock::time_point LastReceiveTime() const {
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(last_receive_time.load()));
+    }
+
+    // Returns std::nullopt if no message is partially received.
+    std::optional<std::chrono::steady_clock::time_point> MessageStartTime() const {
+        auto time = message_start_time.load();
+        if (time == 0) {
+            return std::nullopt;
+        }
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(time));
+    }
+
+    const ConnectionOptions& Options() const {
+        return options;
+    }
+
+#ifndef _WIN32
+    // A duplicate of the handle of the system, e.g. to poll the socket while nobody receives from it.
+    // The caller closes it. Returns -1 if the socket is closed.
+    int DuplicateHandle() {
+        std::lock_guard lk(mutex_close);
+        return closed ? -1 : dup(socket_read->handle());
+    }
+#endif
+
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+    // Let the connection be handed over. Receive() then waits for the wake pipe along with the socket.
+    void EnableHandover(std::shared_ptr<Handover::WakePipe> wake) {
+        handover_wake = wake;
+    }
+
+    // Ask the thread in Receive() to detach the connection at the next frame. The caller then wakes the pipe.
+    // Returns false if the connection is closed, or cannot be handed over.
+    bool RequestHandover() {
+        std::lock_guard lk(mutex_close);
+        int expected = kServing;
+        return closed == false && handover_wake && handover_state.compare_exchange_strong(expected, kRequested);
+    }
+
+    // Wait until the connection is detached, or the deadline. Returns a duplicate of the socket, to be sent to
+    // the new process and closed, and sets bytes to the received bytes that were not consumed.
+    // Returns -1 if the connection stays in this process. Either way, FinishHandover() must follow.
+    int WaitForHandover(std::chrono::steady_clock::time_point deadline, std::string& bytes) {
+        std::unique_lock lk(mutex_close);
+        condition_close.wait_until(lk, deadline, [this] { return closed || handover_state != kRequested; });
+        int expected = kRequested;
+        if (handover_state.compare_exchange_strong(expected, kKept) || expected != kDetached) {
+            return -1;
+        }
+        bytes = handover_bytes;  // Kept until the new process acknowledges, in case it fails
+        return dup(socket_read->handle());
+    }
+
+    // End the handover that RequestHandover() started. If the new process acknowledged it, a detached connection
+    // ends here, and stays open there. Otherwise it is served here again, and may be handed over next time.
+    void FinishHandover(bool handed_over) {
+        std::lock_guard lk(mutex_close);
+        int state = handover_state;
+        handover_state = state == kDetached && handed_over ? kHandedOver : kServing;
+        condition_close.notify_all();
+        if (state == kDetached && closed) {
+            CloseHandles(handover_state != kHandedOver);  // Deferred by Close()
+        }
+    }
+#endif
+
+    // Start with the bytes that the server which handed the connection over had received.
+    // Returns false if they exceed the budget.
+    bool Preload(std::string bytes) {
+        if (budget && budget->TryAcquire(bytes.size()) == false) {
+            return false;
+        }
+        received_string = std::move(bytes);
+        return true;
+    }
+
+   private:
+    static std::string Encode(const Message& message, DeltaEncoder* delta_encoder = nullptr, std::uint64_t trace_id = 0) {
         nlohmann::json message_json = {
             {"op", static_cast<int>(message.opcode)},
-            {"data1", message.data1},
-            {"data2", message.data2},
-            {"data3", message.data3},
         };
+        if (delta_encoder) {
+            delta_encoder->Encode(message, message_json);
+        } else {
+            message_json["data1"] = message.data1;
+            message_json["data2"] = message.data2;
+            message_json["data3"] = message.data3;
+        }
+        if (trace_id != 0) {
+            message_json["trace"] = {trace_id, TraceRecorder::Now()};
+        }
+        if (message.correlation_id != 0) {
+            message_json["correlation"] = message.correlation_id;
+        }
         std::string message_json_str = message_json.dump();
         assert(message_json_str.find('\n') == std::string::npos);  // Ensure that the message does not contain a newline character
-        std::string message_str = message_json_str + "\n";
+        // ReceiveView() of the peer finds the opcode and the correlation ID without parsing, by the order of the keys.
+        // A key that sorts after "op", other than "trace", would send every frame down the slow path.
+        assert([&] {
+            Opcode opcode;
+            bool has_opcode = FrameScanner::ScanOpcode(message_json_str, opcode) && opcode == message.opcode;
+            return (has_opcode || trace_id != 0) &&
+                   FrameScanner::ScanCorrelation(message_json_str) == message.correlation_id;
+        }());
+        if (delta_encoder) {
+            delta_encoder->Commit(message);
+        }
+        return message_json_str + "\n";
+    }
+
+    std::uint64_t TraceIdToSend(Opcode opcode) {
+        if (IsControlOpcode(opcode)) {
+            return 0;
+        }
+        std::uint64_t trace_id = CurrentTraceId();
+        if (trace_id == 0 && options.trace_sample_rate > 0) {
+            trace_id = TraceRecorder::Sample(options.trace_sample_rate);
+        }
+        return trace_id;
+    }
+
+    // Lock mutex_write for Send(), which SendBulk() lets go before its next chunk
+    void LockAheadOfBulk(std::unique_lock<std::mutex>& lk) {
+        priority_senders++;
+        lk.lock();
+        if (--priority_senders == 0) {
+            condition_write.notify_all();  // SendBulk() continues once the lock is released
+        }
+    }
+
+    // Send a frame of the bulk lane, after the frames of Send() that are waiting
+    void WriteBulk(const std::string& message_str) {
+        WaitForSendQueue();
+        std::unique_lock lk(mutex_write);
+        condition_write.wait(lk, [this] { return priority_senders == 0; });
+        Write(message_str);
+    }
+
+    // Wait until the kernel has sent most of the previous chunks, so that the messages of Send()
+    // do not queue behind them in the kernel either. Not supported on all systems.
+    void WaitForSendQueue() {
+#if defined(TCP_NOTSENT_LOWAT) && !defined(_WIN32)
+        if (bulk_low_watermark_set == false) {
+            // The socket becomes writable when less than a chunk is waiting to be sent
+            int low_watermark = static_cast<int>(std::min<std::size_t>(options.bulk_chunk_size, 1 << 30));
+            socket_write->set_option(IPPROTO_TCP, TCP_NOTSENT_LOWAT, low_watermark);
+            bulk_low_watermark_set = true;
+        }
+        pollfd writable{socket_write->handle(), POLLOUT, 0};
+        poll(&writable, 1, -1);  // Close() wakes it up with POLLHUP
+#endif
+    }
+
+    // Send a whole frame. mutex_write must be held.
+    void Write(const std::string& message_str) {
+        if (handover_state == kHandedOver) {
+            throw BrokenPipeException("The connection was handed over to a new process");
+        }
+#ifdef NETWORK_FRAMEWORK_HAS_IO_URING
+        if (auto ring = Ring()) {
+            long result = ring->Send(socket_write->handle(), message_str.data(), message_str.size());
+            if (result < 0) {
+                throw BrokenPipeException(std::strerror(static_cast<int>(-result)));
+            }
+            return;
+        }
+#endif
+        CountSocketSyscall();
         auto result = socket_write->send(message_str);
         if (result.is_error()) {
             throw BrokenPipeException(result.error_message());
         }
     }
 
-    std::optional<Message> Receive() override {
-        // Receive the message from the server
-        while (received_string.find('\n') == std::string::npos) {
-            if (socket_read->is_open() == false) {
+    // Apply ConnectionOptions::receive_rate_limit to a received message of size bytes, which counts toward the
+    // message limit if counted is true. Returns false if it is dropped.
+    bool Admit(std::size_t size, bool counted = true) {
+        if (!rate_limiter) {
+            return true;
+        }
+        std::chrono::nanoseconds delay;
+        std::string exceeded_limit;
+        double exceeded_value;
+        if (rate_limiter->Admit(size, counted, std::chrono::steady_clock::now(), delay, exceeded_limit, exceeded_value) == false) {
+            if (rate_limiter->Action() == RateLimitAction::Drop) {
+                return false;
+            }
+            RejectPeer(exceeded_limit, static_cast<std::size_t>(exceeded_value), false);
+        }
+        if (delay.count() > 0) {
+            std::unique_lock lk(mutex_close);
+            condition_close.wait_for(lk, delay, [this] { return closed; });  // Close() ends the delay
+        }
+        return true;
+    }
+
+    // Record the spans of a received message, if it is traced, and start its dispatch span.
+    void TraceReceived(Opcode opcode) {
+        if (frame_trace_id == 0) {
+            return;
+        }
+        std::uint64_t now = TraceRecorder::Now();
+        std::uint64_t received = TraceRecorder::FromSteadyClock(frame_receive_end);
+        TraceRecorder::Record("recv", frame_trace_id, opcode, TraceRecorder::FromSteadyClock(frame_receive_start),
+                              received, frame_sent_time);
+        TraceRecorder::Record("decode", frame_trace_id, opcode, received, now);
+        TraceRecorder::BeginDispatch(frame_trace_id, opcode, now);
+    }
+
+    // Returns true if message is a control message, which is handled here and not returned to the caller.
+    // size is as set by DecodeFrame(). The control messages count toward the byte rate limit, and a ping,
+    // which is answered, toward the message limit too. A control opcode that this version does not know,
+    // or one that comes in a bulk frame, closes the connection.
+    bool HandleControl(const Message& message, std::size_t size) {
+        if (IsControlOpcode(message.opcode) == false) {
+            return false;
+        }
+        bool known = message.opcode == OpHeartbeatPing || message.opcode == OpHeartbeatPong ||
+                     message.opcode == OpDeltaOffer || message.opcode == OpDeltaAccept;
+        if (known == false || size == 0) {
+            Close();
+            throw InvalidMessageException("op " + std::to_string(message.opcode), "Reserved opcode that is not a control message");
+        }
+        if (Admit(size, message.opcode == OpHeartbeatPing) == false) {
+            return true;  // Dropped
+        }
+        try {
+            if (message.opcode == OpHeartbeatPing) {
+                Send(Message(OpHeartbeatPong));
+            } else if (message.opcode == OpDeltaOffer && options.accept_delta_encoding && !delta_decoder) {
+                // Every delta frame of the peer is sent after it receives the acceptance
+                delta_decoder = std::make_unique<DeltaDecoder>();
+                Send(Message(OpDeltaAccept));
+            } else if (message.opcode == OpDeltaAccept) {
+                delta_encoding = true;
+            }
+        } catch (const BrokenPipeException&) {
+            // The next receive reports the closed connection
+        }
+        return true;
+    }
+
+    // Returns the next frame without its newline, or std::nullopt if the connection was closed.
+    // The frame refers to received_string, so it is valid until the next call.
+    std::optional<std::string_view> NextFrame() {
+        if (TryDetach()) {
+            return std::nullopt;
+        }
+        if (received_offset > 0 && received_offset == received_string.size()) {
+            // Dropped here instead of when the last frame is taken, so that a MessageView of it stays valid
+            received_string.clear();
+            received_offset = 0;
+            scanned_length = 0;
+        }
+        // The frame begins in the last chunk if part of it is buffered, otherwise in the next one
+        auto frame_start = received_offset < received_string.size() ? last_receive_time.load() : 0;
+        std::size_t newline_index;
+        while ((newline_index = received_string.find('\n', std::max(scanned_length, received_offset))) == std::string::npos) {
+            scanned_length = received_string.size();
+            if (socket_read->is_open() == false || WaitUntilReadable() == false) {
                 return std::nullopt;
             }
             bool result = ReceiveOne();
             if (result == false) {
                 return std::nullopt;
             }
+            if (frame_start == 0) {
+                frame_start = last_receive_time.load();
+            }
+        }
+        frame_receive_start = frame_start;
+        frame_receive_end = last_receive_time.load();
+        if (newline_index - received_offset > options.max_message_size) {
+            // Several messages may arrive in one chunk, so only the first one is checked in ReceiveOne()
+            RejectPeer("max_message_size", options.max_message_size, false);
+        }
+        std::string_view frame(received_string.data() + received_offset, newline_index - received_offset);
+        if (budget) {
+            budget->Release(newline_index + 1 - received_offset);
+        }
+        // Erasing the front for every message would be quadratic in the number of buffered messages
+        received_offset = newline_index + 1;
+        return frame;
+    }
+
+    // Called between frames by the thread in Receive(). Returns true if the connection was handed over.
+    // A detached connection waits here, without sending, until the new process acknowledges the handover or fails.
+    bool TryDetach() {
+        if (handover_state.load(std::memory_order_relaxed) != kRequested) {
+            return false;
+        }
+        std::lock_guard write_lock(mutex_write);  // A frame that is being sent is finished first
+        std::unique_lock lk(mutex_close);
+        int expected = kRequested;
+        // The history of delta encoding and the partial bulk frames are not handed over, so such connections stay
+        bool stateless = !delta_decoder && delta_encoding == false && partial_frames.empty();
+        if (handover_state.compare_exchange_strong(expected, stateless && closed == false ? kDetached : kKept) == false) {
+            return false;
+        }
+        condition_close.notify_all();
+        if (handover_state != kDetached) {
+            return false;
+        }
+        handover_bytes = received_string.substr(received_offset);
+        condition_close.wait(lk, [this] { return handover_state != kDetached; });
+        handover_bytes.clear();
+        if (handover_state != kHandedOver) {
+            return false;
+        }
+        if (budget) {
+            budget->Release(received_string.size() - received_offset);
+        }
+        received_string.clear();
+        received_offset = 0;
+        scanned_length = 0;
+        return true;
+    }
+
+    // Shut the connection down, unless it stays open in another process, and close it. mutex_close must be held.
+    void CloseHandles(bool shutdown) {
+        if (shutdown) {
+            socket_write->shutdown();
+            socket_read->shutdown();
+        }
+        socket_write->close();
+        socket_read->close();
+    }
+
+    // Wait until the socket is readable. Returns false if the connection is detached to be handed over meanwhile.
+    bool WaitUntilReadable() {
+#ifdef NETWORK_FRAMEWORK_HAS_HANDOVER
+        // The pipe stays readable during a handover, so a connection that is not requested then polls on a tick
+        constexpr int kHandoverTick = 10;  // Milliseconds
+        bool awake = false;
+        while (handover_wake) {
+            pollfd fds[2] = {{socket_read->handle(), POLLIN, 0}, {handover_wake->Handle(), POLLIN, 0}};
+            if (poll(fds, awake ? 1 : 2, awake ? kHandoverTick : -1) < 0 && errno != EINTR) {
+                return true;  // The receive reports the error
+            }
+            if (TryDetach()) {
+                return false;
+            }
+            if (fds[0].revents != 0) {
+                return true;
+            }
+            awake = fds[1].revents != 0 && handover_state != kRequested;
+        }
+#endif
+        return true;
+    }
+
+    // Parse a frame, and reassemble the chunks of bulk frames. Returns std::nullopt if the frame is a chunk that
+    // does not complete its bulk frame. size is set to the size of the message on the wire that the rate limit
+    // still has to admit, which is 0 for a bulk frame, since each of its chunks is admitted when it arrives.
+    std::optional<Message> DecodeFrame(std::string_view frame, std::size_t& size) {
+        auto message = ParseFrame(frame);
+        size = frame.size() + 1;
+        if (message.opcode != OpChunk) {
+            return message;
+        }
+        bool admitted = Admit(size);
+        size = 0;
+        auto found = partial_frames.find(message.data1);
+        if (found == partial_frames.end()) {
+            if (partial_frames.size() >= options.max_open_bulk_frames) {
+                RejectPeer("max_open_bulk_frames", options.max_open_bulk_frames, false);
+            }
+            ChargePartialFrames(message.data1.size() + kPartialFrameOverhead);
+            found = partial_frames.emplace(message.data1, PartialFrame()).first;
+        }
+        auto& partial = found->second;
+        if (admitted == false && partial.dropped == false) {
+            ReleasePartialFrames(partial.text.size());
+            partial.text = std::string();
+            partial.dropped = true;
+        }
+        if (partial.dropped == false) {
+            std::size_t piece = message.data2.size();
+            if (partial.text.size() + piece > options.max_message_size) {
+                RejectPeer("max_message_size", options.max_message_size, false);
+            }
+            ChargePartialFrames(piece);
+            partial.text += message.data2;
+        }
+        if (message.data3 != "1") {
+            return std::nullopt;
+        }
+        bool dropped = partial.dropped;
+        reassembled_frame = std::move(partial.text);
+        ReleasePartialFrames(reassembled_frame.size() + found->first.size() + kPartialFrameOverhead);
+        partial_frames.erase(found);
+        if (dropped) {
+            return std::nullopt;
+        }
+        return ParseFrame(reassembled_frame);
+    }
+
+    // Account for memory that partial_frames takes, within ConnectionOptions::max_receive_buffer_size and the budget.
+    void ChargePartialFrames(std::size_t size) {
+        if (partial_frames_size + size > options.max_receive_buffer_size) {
+            RejectPeer("max_receive_buffer_size", options.max_receive_buffer_size, false);
+        }
+        if (budget && budget->TryAcquire(size) == false) {
+            RejectPeer("receive_memory_budget", budget->Limit(), true);
+        }
+        partial_frames_size += size;
+    }
+
+    void ReleasePartialFrames(std::size_t size) {
+        partial_frames_size -= size;
+        if (budget) {
+            budget->Release(size);
         }
-        auto newline_index = received_string.find('\n');
-        std::string message_str = received_string.substr(0, newline_index);
-        received_string = received_string.substr(newline_index + 1);
+    }
+
+    Message ParseFrame(std::string_view frame) {
+        std::string message_str(frame);
         nlohmann::json message_json;
         try {
             message_json = nlohmann::json::parse(message_str);
+            frame_trace_id = 0;
+            auto trace = message_json.find("trace");
+            if (trace != message_json.end() && trace->is_array() && trace->size() == 2 &&
+                (*trace)[0].is_number_unsigned() && (*trace)[1].is_number_unsigned()) {
+                frame_trace_id = (*trace)[0].get<std::uint64_t>();
+                frame_sent_time = (*trace)[1].get<std::uint64_t>();
+            }
             Message message;
             if (message_json.contains("op") && message_json["op"].is_number_integer()) {
                 message.opcode = static_cast<Opcode>(message_json["op"].get<int>());
@@ -84,6 +711,19 @@ class SockppSocket final : public Socket {
                     message_str,
                     "Missing or invalid opcode");
             }
+            auto correlation = message_json.find("correlation");
+            if (correlation != message_json.end() && correlation->is_number_unsigned()) {
+                message.correlation_id = correlation->get<std::uint64_t>();
+            }
+            if (message_json.contains("delta")) {
+                if (!delta_decoder) {
+                    throw InvalidMessageException(
+                        message_str,
+                        "Delta encoding is not accepted");
+                }
+                delta_decoder->Decode(message_json, message, message_str);
+                return message;
+            }
             if (message_json.contains("data1") && message_json["data1"].is_string()) {
                 message.data1 = message_json["data1"].get<std::string>();
             } else {
@@ -113,45 +753,101 @@ class SockppSocket final : public Socket {
         }
     }
 
-    void Close() override {
-        // Close the connection
-        socket_write->shutdown();
-        socket_write->close();
-        socket_read->shutdown();
-        socket_read->close();
-    }
-
-    std::string PeerAddress() const override {
-        return peer_address;
-    }
-
-    int PeerPort() const override {
-        return peer_port;
-    }
-
-   private:
     bool ReceiveOne() {
         std::lock_guard lk(mutex_read);
         if (socket_read->is_open() == false) {
             return false;
         }
-        char buffer[1024 + 1];
-        auto result = socket_read->recv(buffer, sizeof(buffer) - 1);
-        if (result.is_error()) {
-            throw BrokenPipeException(result.error_message());
+        char stack_buffer[kDefaultReceiveChunkSize];
+        const char* buffer = stack_buffer;
+        std::size_t length;
+#ifdef NETWORK_FRAMEWORK_HAS_IO_URING
+        if (auto ring = Ring()) {
+            // Received into the registered buffer of this thread
+            std::size_t chunk_size = options.receive_chunk_size != 0 ? options.receive_chunk_size : IoUring::kReceiveBufferSize;
+            long result = ring->Receive(socket_read->handle(), &buffer, chunk_size);
+            if (result < 0) {
+                throw BrokenPipeException(std::strerror(static_cast<int>(-result)));
+            }
+            length = static_cast<std::size_t>(result);
+        } else
+#endif
+        {
+            char* target = stack_buffer;
+            std::size_t chunk_size = options.receive_chunk_size != 0 ? options.receive_chunk_size : sizeof(stack_buffer);
+            if (chunk_size > sizeof(stack_buffer)) {
+                // Copied into received_string before the next receive on this thread, like the buffer of io_uring
+                thread_local std::vector<char> large_buffer;
+                large_buffer.resize(std::max(large_buffer.size(), chunk_size));
+                target = large_buffer.data();
+                buffer = target;
+            }
+            CountSocketSyscall();
+            auto result = socket_read->recv(target, chunk_size);
+            if (result.is_error()) {
+                throw BrokenPipeException(result.error_message());
+            }
+            length = result.value();
         }
-        auto length = result.value();
         if (length == 0) {
             return false;
         }
-        assert(length < sizeof(buffer));
-        buffer[length] = '\0';
-        if (length > 0 && buffer[length - 1] != '\n') {
-            printf("Received message without newline character, this may cause bugs in other implementations of the protocol");
+        if (options.socket.quick_ack) {
+            SocketTuning::RearmQuickAck(socket_read->handle());
+        }
+        // Drop the consumed messages, at most once per recv
+        if (received_offset > 0) {
+            received_string.erase(0, received_offset);
+            scanned_length -= std::min(scanned_length, received_offset);
+            received_offset = 0;
+        }
+        // Enforce the limits before the buffer grows. received_string contains no newline here,
+        // so it is the beginning of the message that this chunk continues.
+        auto newline = static_cast<const char*>(memchr(buffer, '\n', length));
+        std::size_t message_size = received_string.size() + (newline ? newline - buffer : length);
+        if (message_size > options.max_message_size) {
+            RejectPeer("max_message_size", options.max_message_size, false);
+        }
+        if (received_string.size() + length > options.max_receive_buffer_size) {
+            RejectPeer("max_receive_buffer_size", options.max_receive_buffer_size, false);
+        }
+        if (budget && budget->TryAcquire(length) == false) {
+            RejectPeer("receive_memory_budget", budget->Limit(), true);
+        }
+        received_string.append(buffer, length);
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        last_receive_time = now;
+        if (newline != nullptr) {
+            bool has_partial_message = buffer[length - 1] != '\n';
+            message_start_time = has_partial_message ? now : 0;
+        } else if (message_start_time.load() == 0) {
+            message_start_time = now;
         }
-        received_string += buffer;
         return true;
     }
+
+#ifdef NETWORK_FRAMEWORK_HAS_IO_URING
+    // Returns nullptr if the Sockpp backend is used
+    IoUring* Ring() const {
+        return options.backend == SocketBackend::IoUring ? IoUring::ForThisThread() : nullptr;
+    }
+#endif
+
+    [[noreturn]] void RejectPeer(const std::string& limit_name, std::size_t limit, bool is_budget) {
+        if (budget) {
+            if (is_budget == false) {
+                budget->RecordConnectionLimitRejection();
+            }
+            budget->Release(received_string.size() - received_offset + partial_frames_size);
+        }
+        partial_frames.clear();
+        partial_frames_size = 0;
+        received_string.clear();
+        received_offset = 0;
+        scanned_length = 0;
+        Close();
+        throw ReceiveLimitExceededException(limit_name, limit);
+    }
 };
 
 }  // namespace NetworkFramework
@@ -0,0 +1,98 @@
+/*
+ *  Description: This file implements NetworkFramework::TimerThread,
+ *               which drives a NetworkFramework::TimingWheel in a
+ *               background thread, so that any thread can schedule timers.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "timing_wheel.h"
+
+namespace NetworkFramework {
+
+class TimerThread {
+   private:
+    std::chrono::steady_clock::duration tick_;
+    std::chrono::steady_clock::time_point start_;
+    TimingWheel wheel_;
+    std::mutex mutex_;
+    std::condition_variable condition_variable_;
+    bool stopped_ = false;
+    std::thread thread_;
+
+   public:
+    explicit TimerThread(std::chrono::steady_clock::duration tick)
+        : tick_(tick > std::chrono::steady_clock::duration::zero() ? tick : std::chrono::milliseconds(1)),
+          start_(std::chrono::steady_clock::now()),
+          thread_([this]() { Run(); }) {}
+
+    ~TimerThread() {
+        Stop();
+    }
+
+    // Run callback in the timer thread after delay, rounded up to the next tick.
+    // Callbacks must not block, since they delay all other timers.
+    TimingWheel::TimerId Schedule(std::chrono::steady_clock::duration delay, TimingWheel::Callback callback) {
+        std::lock_guard lk(mutex_);
+        // The wheel may lag behind the clock by the ticks that are being processed
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        std::uint64_t now_tick = static_cast<std::uint64_t>(elapsed / tick_);
+        std::uint64_t target_tick = now_tick + static_cast<std::uint64_t>((delay + tick_ - std::chrono::steady_clock::duration(1)) / tick_);
+        std::uint64_t current_tick = wheel_.CurrentTick();
+        std::uint64_t delay_ticks = target_tick > current_tick ? target_tick - current_tick : 0;
+        return wheel_.Schedule(delay_ticks, std::move(callback));
+    }
+
+    bool Cancel(TimingWheel::TimerId id) {
+        std::lock_guard lk(mutex_);
+        return wheel_.Cancel(id);
+    }
+
+    void Stop() {
+        {
+            std::lock_guard lk(mutex_);
+            stopped_ = true;
+        }
+        condition_variable_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+   private:
+    void Run() {
+        std::vector<TimingWheel::Callback> expired;
+        std::unique_lock lk(mutex_);
+        while (stopped_ == false) {
+            auto next_tick_time = start_ + tick_ * static_cast<std::int64_t>(wheel_.CurrentTick());
+            condition_variable_.wait_until(lk, next_tick_time, [this] { return stopped_; });
+            if (stopped_) {
+                break;
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            std::uint64_t now_tick = static_cast<std::uint64_t>(elapsed / tick_);
+            while (wheel_.CurrentTick() <= now_tick) {
+                wheel_.Tick(expired);
+            }
+            lk.unlock();
+            for (auto& callback : expired) {
+                callback();
+            }
+            expired.clear();
+            lk.lock();
+        }
+    }
+};
+
+}  // namespace NetworkFramework
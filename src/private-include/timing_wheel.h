@@ -0,0 +1,126 @@
+/*
+ *  Description: This file implements NetworkFramework::TimingWheel,
+ *               a hierarchical timing wheel, in which scheduling and
+ *               canceling a timer are O(1).
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace NetworkFramework {
+
+// Not thread-safe, see TimerThread for a thread-safe wrapper.
+//
+// Level 0 has one slot per tick, and each slot of level n covers 64^n ticks.
+// When level 0 wraps around, the next slot of level 1 is moved down to the levels below,
+// and so on, so each timer is moved at most kLevels - 1 times during its lifetime.
+class TimingWheel {
+   public:
+    using Callback = std::function<void()>;
+    using TimerId = std::uint64_t;
+
+   private:
+    static constexpr int kSlotBits = 6;
+    static constexpr int kSlots = 1 << kSlotBits;
+    static constexpr int kLevels = 4;
+    static constexpr std::uint64_t kMaxDelay = (std::uint64_t(1) << (kSlotBits * kLevels)) - 1;
+
+    struct Timer {
+        TimerId id;
+        std::uint64_t expires;
+        int level;
+        int slot;
+        Callback callback;
+    };
+    using Slot = std::list<Timer>;
+
+    std::array<std::array<Slot, kSlots>, kLevels> slots_;
+    std::unordered_map<TimerId, Slot::iterator> timers_;
+    std::uint64_t current_tick_ = 0;  // The next tick to be processed
+    TimerId next_id_ = 1;
+
+   public:
+    // Schedule callback to be returned by the Tick() that processes current_tick + delay_ticks.
+    // Delays longer than 64^4 - 1 ticks are shortened to it.
+    TimerId Schedule(std::uint64_t delay_ticks, Callback callback) {
+        if (delay_ticks > kMaxDelay) {
+            delay_ticks = kMaxDelay;
+        }
+        Slot staging;
+        staging.push_back(Timer{next_id_++, current_tick_ + delay_ticks, 0, 0, std::move(callback)});
+        auto it = staging.begin();
+        timers_.emplace(it->id, it);
+        Place(staging, it);
+        return it->id;
+    }
+
+    // Returns false if the timer has already expired or been canceled.
+    bool Cancel(TimerId id) {
+        auto found = timers_.find(id);
+        if (found == timers_.end()) {
+            return false;
+        }
+        auto it = found->second;
+        slots_[it->level][it->slot].erase(it);
+        timers_.erase(found);
+        return true;
+    }
+
+    // Process the current tick, appending the callbacks of the expired timers to expired.
+    void Tick(std::vector<Callback>& expired) {
+        // Cascade the higher levels whose slot starts at this tick
+        for (int level = 1; level < kLevels; level++) {
+            if ((current_tick_ & ((std::uint64_t(1) << (kSlotBits * level)) - 1)) != 0) {
+                break;
+            }
+            auto& slot = slots_[level][(current_tick_ >> (kSlotBits * level)) & (kSlots - 1)];
+            while (slot.empty() == false) {
+                Place(slot, slot.begin());
+            }
+        }
+        auto& slot = slots_[0][current_tick_ & (kSlots - 1)];
+        for (auto& timer : slot) {
+            timers_.erase(timer.id);
+            expired.push_back(std::move(timer.callback));
+        }
+        slot.clear();
+        current_tick_++;
+    }
+
+    std::uint64_t CurrentTick() const {
+        return current_tick_;
+    }
+
+    std::size_t Size() const {
+        return timers_.size();
+    }
+
+   private:
+    // Move the timer at it, which is in from, to the slot that matches its remaining delay.
+    // Iterators into std::list stay valid when spliced, so timers_ does not need to be updated.
+    void Place(Slot& from, Slot::iterator it) {
+        std::uint64_t delay = it->expires - current_tick_;
+        int level = 0;
+        while (level < kLevels - 1 && delay >= (std::uint64_t(1) << (kSlotBits * (level + 1)))) {
+            level++;
+        }
+        it->level = level;
+        it->slot = static_cast<int>((it->expires >> (kSlotBits * level)) & (kSlots - 1));
+        auto& to = slots_[level][it->slot];
+        to.splice(to.end(), from, it);
+    }
+};
+
+}  // namespace NetworkFramework
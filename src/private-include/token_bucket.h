@@ -0,0 +1,109 @@
+/*
+ *  Description: This file implements NetworkFramework::TokenBucket and
+ *               NetworkFramework::RateLimiter, which enforce
+ *               NetworkFramework::ReceiveRateLimit on a connection.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include "options.h"
+
+namespace NetworkFramework {
+
+class TokenBucket {
+   private:
+    double rate_;  // Tokens per second, or 0 if unlimited
+    double burst_;
+    double tokens_;
+    std::chrono::steady_clock::time_point last_refill_;
+
+   public:
+    TokenBucket(double rate, double burst, std::chrono::steady_clock::time_point now)
+        : rate_(std::max(rate, 0.0)),
+          burst_(burst > 0 ? burst : rate_),
+          tokens_(burst_),
+          last_refill_(now) {}
+
+    bool Unlimited() const {
+        return rate_ == 0;
+    }
+
+    double Rate() const {
+        return rate_;
+    }
+
+    // Whether amount tokens can be taken now. An amount larger than the burst can be taken when the bucket is full.
+    bool Available(double amount, std::chrono::steady_clock::time_point now) {
+        if (Unlimited()) {
+            return true;
+        }
+        tokens_ = std::min(burst_, tokens_ + rate_ * std::chrono::duration<double>(now - last_refill_).count());
+        last_refill_ = now;
+        return tokens_ >= std::min(amount, burst_);
+    }
+
+    // Take amount tokens, even if they are not available, and return how long the bucket is in debt.
+    // Available() must be called first, to refill the bucket.
+    std::chrono::nanoseconds Take(double amount) {
+        if (Unlimited()) {
+            return std::chrono::nanoseconds(0);
+        }
+        tokens_ -= amount;
+        if (tokens_ >= 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        return std::chrono::nanoseconds(static_cast<long long>(-tokens_ / rate_ * 1e9));
+    }
+};
+
+class RateLimiter {
+   private:
+    RateLimitAction action_;
+    TokenBucket messages_;
+    TokenBucket bytes_;
+
+   public:
+    explicit RateLimiter(const ReceiveRateLimit& limit, std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now())
+        : action_(limit.action),
+          messages_(limit.messages_per_second, limit.message_burst, now),
+          bytes_(limit.bytes_per_second, limit.byte_burst, now) {}
+
+    bool Unlimited() const {
+        return messages_.Unlimited() && bytes_.Unlimited();
+    }
+
+    RateLimitAction Action() const {
+        return action_;
+    }
+
+    // Account for a message of size bytes, which counts toward the message limit if counted is true.
+    // Returns true if it is within the limits, otherwise sets the name and the value of the exceeded limit,
+    // and takes nothing. With RateLimitAction::Delay, every message is accepted, and delay is set to how long
+    // to hold it.
+    bool Admit(std::size_t size, bool counted, std::chrono::steady_clock::time_point now, std::chrono::nanoseconds& delay,
+               std::string& exceeded_limit, double& exceeded_value) {
+        delay = std::chrono::nanoseconds(0);
+        bool messages_available = counted == false || messages_.Available(1, now);
+        bool bytes_available = bytes_.Available(static_cast<double>(size), now);
+        if (action_ != RateLimitAction::Delay && (messages_available == false || bytes_available == false)) {
+            exceeded_limit = messages_available ? "receive_rate_limit.bytes_per_second"
+                                                : "receive_rate_limit.messages_per_second";
+            exceeded_value = messages_available ? bytes_.Rate() : messages_.Rate();
+            return false;
+        }
+        delay = std::max(messages_.Take(counted ? 1 : 0), bytes_.Take(static_cast<double>(size)));
+        return true;
+    }
+};
+
+}  // namespace NetworkFramework
@@ -0,0 +1,74 @@
+/*
+ *  Description: This file declares the recording of the spans of traced
+ *               messages, implemented in src/tracing.cpp, which the sockets
+ *               use to implement include/tracing.h.
+ *
+ *               Every thread records into its own buffer without locks, so a
+ *               span costs a few relaxed atomic stores. Messages that are not
+ *               traced record nothing and read the clock no more than before.
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include "message.h"
+#include "tracing.h"
+
+namespace NetworkFramework {
+
+namespace TraceRecorder {
+
+// Nanoseconds of the steady clock
+inline std::uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Converts a time point of the steady clock, stored as its count, as ConnectionOptions timestamps are
+inline std::uint64_t FromSteadyClock(std::chrono::steady_clock::rep count) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::duration(count)).count();
+}
+
+// Record a span [start, end] of a trace into the buffer of this thread.
+// arg is shown with the span if it is not 0, e.g. the time at which the peer sent a received message.
+void Record(const char* name, std::uint64_t trace_id, Opcode opcode, std::uint64_t start, std::uint64_t end,
+            std::uint64_t arg = 0);
+
+// Returns a new trace ID with the probability rate, or 0.
+std::uint64_t Sample(double rate);
+
+// Called when Receive() returns a message: the messages sent until the next receive belong to its trace.
+void BeginDispatch(std::uint64_t trace_id, Opcode opcode, std::uint64_t now);
+
+// Called when Receive() is entered: records the dispatch span of the previous message, if it was traced.
+void EndDispatch();
+
+// Records consecutive spans of a message, each from the end of the previous one. It does nothing if trace_id is 0.
+class Timer {
+   private:
+    std::uint64_t trace_id_;
+    Opcode opcode_;
+    std::uint64_t last_;
+
+   public:
+    Timer(std::uint64_t trace_id, Opcode opcode)
+        : trace_id_(trace_id), opcode_(opcode), last_(trace_id != 0 ? Now() : 0) {}
+
+    void Span(const char* name) {
+        if (trace_id_ != 0) {
+            std::uint64_t now = Now();
+            Record(name, trace_id_, opcode_, last_, now);
+            last_ = now;
+        }
+    }
+};
+
+}  // namespace TraceRecorder
+
+}  // namespace NetworkFramework
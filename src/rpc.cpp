@@ -0,0 +1,53 @@
+/*
+ *  Description: This file implements NetworkFramework::RpcClient and
+ *               NetworkFramework::RpcService defined in include/rpc.h,
+ *               using NetworkFramework::RpcClientImpl and
+ *               NetworkFramework::RpcServiceImpl
+ *               defined in src/private-include/rpc_impl.h
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#include "rpc.h"
+#include "rpc_impl.h"
+
+NetworkFramework::RpcClient::RpcClient(std::shared_ptr<Socket> socket, MessageHandler on_message) {
+    impl_ = std::make_unique<RpcClientImpl>(std::move(socket), std::move(on_message));
+}
+
+NetworkFramework::RpcClient::~RpcClient() {
+    if (impl_->InReceiver()) {
+        impl_.release()->DeleteWhenReceived();
+    }
+}
+
+std::future<NetworkFramework::Message> NetworkFramework::RpcClient::Call(Message request) {
+    return impl_->Call(std::move(request));
+}
+
+void NetworkFramework::RpcClient::Call(Message request, Callback on_response) {
+    impl_->Call(std::move(request), std::move(on_response));
+}
+
+std::size_t NetworkFramework::RpcClient::PendingCount() const {
+    return impl_->PendingCount();
+}
+
+void NetworkFramework::RpcClient::Close() {
+    impl_->Close();
+}
+
+NetworkFramework::RpcService::RpcService(Handler handler, const RpcServiceOptions& options) {
+    impl_ = std::make_unique<RpcServiceImpl>(std::move(handler), options);
+}
+
+NetworkFramework::RpcService::~RpcService() = default;
+
+void NetworkFramework::RpcService::Execute(std::shared_ptr<Socket> socket) {
+    impl_->Execute(std::move(socket));
+}
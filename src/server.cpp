@@ -15,8 +15,8 @@
 #include "server.h"
 #include "server_impl.h"
 
-NetworkFramework::Server::Server(std::shared_ptr<Service> service, int listen_port) {
-    impl_ = std::make_unique<ServerImpl>(service, listen_port);
+NetworkFramework::Server::Server(std::shared_ptr<Service> service, int listen_port, const ServerOptions& options) {
+    impl_ = std::make_unique<ServerImpl>(service, listen_port, options);
 }
 
 NetworkFramework::Server::~Server() {
@@ -26,3 +26,15 @@ NetworkFramework::Server::~Server() {
 void NetworkFramework::Server::Shutdown() {
     impl_->Shutdown();
 }
+
+NetworkFramework::ReceiveBufferMetrics NetworkFramework::Server::ReceiveMetrics() const {
+    return impl_->ReceiveMetrics();
+}
+
+std::size_t NetworkFramework::Server::ConnectionCount() const {
+    return impl_->ConnectionCount();
+}
+
+bool NetworkFramework::Server::WaitForHandover() {
+    return impl_->WaitForHandover();
+}
@@ -11,9 +11,26 @@
  *
  */
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
 #include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 #include "network_framework.h"
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 
 // Define the opcodes
 enum MyOpcode : NetworkFramework::Opcode {
@@ -25,6 +42,21 @@ enum MyOpcode : NetworkFramework::Opcode {
     Op4 = 4,
 };
 
+// Define typed messages, which are converted from and to NetworkFramework::Message
+struct MoveMessage {
+    static constexpr NetworkFramework::Opcode opcode = Op3;
+    std::array<int, 2> from;
+    std::array<int, 2> to;
+    std::string comment;
+    using Fields = NetworkFramework::Fields<&MoveMessage::from, &MoveMessage::to, &MoveMessage::comment>;
+};
+
+struct ResignMessage {
+    static constexpr NetworkFramework::Opcode opcode = Op4;
+    int player;
+    using Fields = NetworkFramework::Fields<&ResignMessage::player>;
+};
+
 // Define the service class that handles all connections.
 class RelayService : public NetworkFramework::Service {
    private:
@@ -97,6 +129,128 @@ class RelayService : public NetworkFramework::Service {
     }
 };
 
+// Define a service that sends every message back to the client.
+class EchoService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        while (true) {
+            auto message = socket->Receive();  // May throw ReceiveLimitExceededException, which closes the connection
+            if (message.has_value() == false) {
+                break;
+            }
+            socket->Send(message.value());
+        }
+    }
+};
+
+// An echo service that drops the messages with OpExit without reading them.
+class ViewEchoService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        while (auto view = socket->ReceiveView()) {
+            if (view->opcode != OpExit) {
+                socket->Send(view->ToMessage());
+            }
+        }
+    }
+};
+
+// An echo service that records a span of its own for traced messages.
+class TracedEchoService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        while (auto message = socket->Receive()) {
+            NetworkFramework::TraceSpan span("echo");
+            socket->Send(message.value());
+        }
+    }
+};
+
+// A service that sends a large record on the bulk lane, and meanwhile an urgent message on the default lane.
+class BulkRecordService : public NetworkFramework::Service {
+   public:
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        if (socket->Receive().has_value() == false) {
+            return;
+        }
+        std::thread bulk([socket]() {
+            socket->SendBulk(NetworkFramework::Message(Op3, std::string(8 << 20, 'r'), "\u00e9\u00e9\u00e9"));
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));  // The client does not read yet, so the bulk send blocks
+        socket->Send(NetworkFramework::Message(OpExit, "urgent"));
+        bulk.join();
+        while (socket->Receive().has_value()) {
+        }
+    }
+};
+
+// An echo service that tags its answers with the server that sent them, and takes a while for each message.
+class TaggedEchoService : public NetworkFramework::Service {
+   private:
+    std::string tag;
+    std::chrono::milliseconds delay;
+
+   public:
+    TaggedEchoService(std::string tag, std::chrono::milliseconds delay) : tag(tag), delay(delay) {}
+
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        while (auto message = socket->Receive()) {
+            socket->Send(NetworkFramework::Message(message->opcode, message->data1, tag));
+            std::this_thread::sleep_for(delay);
+        }
+    }
+};
+
+// An echo service that counts the connections that timed out.
+class TimeoutCountingService : public EchoService {
+   public:
+    std::atomic<int> idle_timeouts{0};
+
+    void OnTimeout(std::shared_ptr<NetworkFramework::Socket>, NetworkFramework::TimeoutKind kind) override {
+        if (kind == NetworkFramework::TimeoutKind::Idle) {
+            idle_timeouts++;
+        }
+    }
+};
+
+// A service that groups every 3 connections into a match, without blocking while they wait.
+class MatchService : public NetworkFramework::Service {
+   private:
+    NetworkFramework::Matchmaker matchmaker;
+
+    static NetworkFramework::MatchmakerOptions Options() {
+        NetworkFramework::MatchmakerOptions options;
+        options.players_per_match = 3;
+        options.wait_timeout = std::chrono::milliseconds(300);
+        return options;
+    }
+
+   public:
+    MatchService()
+        : matchmaker(
+              [](std::vector<std::shared_ptr<NetworkFramework::Socket>> players) {
+                  for (std::size_t i = 0; i < players.size(); i++) {
+                      players[i]->Send(NetworkFramework::Message(Op1, std::to_string(i)));
+                  }
+                  // The sockets are closed when the last reference is released
+              },
+              Options(),
+              [](std::shared_ptr<NetworkFramework::Socket> player) {
+                  try {
+                      player->Send(NetworkFramework::Message(OpError, "No match found."));
+                  } catch (const NetworkFramework::BrokenPipeException&) {
+                  }
+              }) {}
+
+    void Execute(std::shared_ptr<NetworkFramework::Socket> socket) override {
+        matchmaker.Enqueue(socket);
+    }
+
+    std::size_t WaitingCount() const {
+        return matchmaker.WaitingCount();
+    }
+};
+
 // System assert() may not work in some cases, so we use our own one.
 void Assert(bool value) {
     if (!value) {
@@ -105,6 +259,661 @@ void Assert(bool value) {
     }
 }
 
+// A peer that exceeds a receive limit is disconnected, and the server keeps serving others.
+void TestReceiveLimits() {
+    constexpr int port = 7778;
+    NetworkFramework::ServerOptions options;
+    options.connection.max_message_size = 64;
+    options.receive_memory_budget = 256;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+
+    auto client1 = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    auto client2 = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    client1->Send(NetworkFramework::Message(Op1, std::string(100, 'x')));
+    Assert(client1->Receive().has_value() == false);
+    client2->Send(NetworkFramework::Message(Op1, "small"));
+    Assert(client2->Receive().value() == NetworkFramework::Message(Op1, "small"));
+
+    auto metrics = server.ReceiveMetrics();
+    Assert(metrics.connection_limit_rejections == 1);
+    Assert(metrics.budget_rejections == 0);
+    Assert(metrics.bytes_in_use == 0);
+    Assert(metrics.peak_bytes_in_use > 0 && metrics.peak_bytes_in_use <= 256);
+}
+
+// A silent peer is reclaimed after the idle timeout, while a peer that answers heartbeats is kept.
+void TestIdleTimeout() {
+    constexpr int port = 7779;
+    NetworkFramework::ServerOptions options;
+    options.connection.idle_timeout = std::chrono::milliseconds(300);
+    options.connection.heartbeat_interval = std::chrono::milliseconds(100);
+    auto service = std::make_shared<TimeoutCountingService>();
+    NetworkFramework::Server server(service, port, options);
+
+    auto start = std::chrono::steady_clock::now();
+    auto silent_client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    auto live_client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    std::thread live_thread([&]() {
+        Assert(live_client->Receive().has_value() == false);  // Answers heartbeats until closed
+    });
+
+    // The silent client never calls Receive(), so it does not answer heartbeats.
+    // It is disconnected after the idle timeout, and its session is reclaimed.
+    // The count passes 1 on its way up too, so wait for both connections first.
+    for (std::size_t count : {2, 1}) {
+        while (server.ConnectionCount() != count) {
+            Assert(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    Assert(elapsed >= std::chrono::milliseconds(300));
+    Assert(elapsed < std::chrono::milliseconds(1000));
+    Assert(service->idle_timeouts == 1);
+    Assert(silent_client->Receive().has_value() == false);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    Assert(server.ConnectionCount() == 1);
+    Assert(service->idle_timeouts == 1);
+
+    live_client->Close();
+    live_thread.join();
+}
+
+// Typed messages survive a round trip, and are dispatched to their handlers by opcode.
+void TestTypedMessages() {
+    constexpr int port = 7780;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+
+    Assert(NetworkFramework::ToMessage(ResignMessage{-2}) == NetworkFramework::Message(Op4, "-2"));
+    client->Send(NetworkFramework::ToMessage(MoveMessage{{1, 2}, {3, 4}, "check"}));
+    client->Send(NetworkFramework::ToMessage(ResignMessage{1}));
+    client->Send(NetworkFramework::Message(Op1, "not routed"));
+
+    int moves = 0, resigns = 0;
+    NetworkFramework::MessageRouter<MoveMessage, ResignMessage> router;
+    router.On<MoveMessage>([&](const MoveMessage& move) {
+        Assert(move.from == std::array<int, 2>{1, 2} && move.to == std::array<int, 2>{3, 4} && move.comment == "check");
+        moves++;
+    });
+    router.On<ResignMessage>([&](const ResignMessage& resign) {
+        Assert(resign.player == 1);
+        resigns++;
+    });
+    Assert(router.Dispatch(client->Receive().value()));
+    Assert(router.Dispatch(client->Receive().value()));
+    Assert(router.Dispatch(client->Receive().value()) == false);
+    Assert(moves == 1 && resigns == 1);
+
+    bool thrown = false;
+    try {
+        router.Dispatch(NetworkFramework::Message(Op3, "1,2", "x"));
+    } catch (const NetworkFramework::InvalidMessageException&) {
+        thrown = true;
+    }
+    Assert(thrown);
+}
+
+// Players are matched in groups of 3 in the order they joined, and a leftover player times out.
+// A player that leaves while waiting is removed, and the waiting players are closed when the server shuts down.
+void TestMatchmaker() {
+    constexpr int port = 7781;
+    auto service = std::make_shared<MatchService>();
+    NetworkFramework::Server server(service, port);
+    auto wait_for_waiting_count = [&](std::size_t count) {
+        auto start = std::chrono::steady_clock::now();
+        while (service->WaitingCount() != count) {
+            Assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(200));  // Before the timeout
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+    std::vector<std::unique_ptr<NetworkFramework::Socket>> clients;
+    for (int i = 0; i < 4; i++) {
+        clients.push_back(NetworkFramework::ConnectToServer("127.0.0.1", port));
+        if (i < 3) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));  // Keep the order of joining
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        Assert(clients[i]->Receive().value() == NetworkFramework::Message(Op1, std::to_string(i)));
+        Assert(clients[i]->Receive().has_value() == false);
+    }
+    Assert(clients[3]->Receive().value().opcode == OpError);
+    Assert(clients[3]->Receive().has_value() == false);
+    wait_for_waiting_count(0);
+
+#ifdef __linux__
+    auto leaving = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    wait_for_waiting_count(1);
+    leaving->Close();
+    wait_for_waiting_count(0);
+#endif
+
+    auto waiting = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    wait_for_waiting_count(1);
+    server.Shutdown();
+    Assert(waiting->Receive().has_value() == false);
+}
+
+// The io_uring backend is interchangeable with the default one, and falls back to it where unsupported.
+void TestIoUringBackend() {
+    constexpr int port = 7782;
+    NetworkFramework::ServerOptions options;
+    options.connection.backend = NetworkFramework::SocketBackend::IoUring;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, 3, options.connection);
+
+    // Larger than the registered receive buffer, so it is received in several pieces
+    NetworkFramework::Message large(Op1, std::string(200000, 'x'), std::string(100, 'y'));
+    client->Send(large);
+    client->Send(NetworkFramework::Message(Op2, "small"));
+    Assert(client->Receive().value() == large);
+    Assert(client->Receive().value() == NetworkFramework::Message(Op2, "small"));
+    client->Close();
+    Assert(client->Receive().has_value() == false);
+
+    // The Sockpp backend reads chunks of the same size if it is told to
+    NetworkFramework::ConnectionOptions chunked;
+    chunked.receive_chunk_size = 64 << 10;
+    auto chunked_client = NetworkFramework::ConnectToServer("127.0.0.1", port, 3, chunked);
+    chunked_client->Send(large);
+    Assert(chunked_client->Receive().value() == large);
+    chunked_client->Close();
+}
+
+// Delta-encoded frames of changing fields, including non-ASCII ones, decode to the messages that were sent.
+void TestDeltaEncoding() {
+    constexpr int port = 7783;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    client->RequestDeltaEncoding();
+
+    // A board that changes by a few cells per move, a growing move list, and a field that is
+    // replaced by a shorter and then a longer value
+    std::string board(36, '.');
+    std::string moves;
+    for (int i = 0; i < 50; i++) {
+        board[i % 36] = 'B';
+        board[(i * 7 + 3) % 36] = i % 2 ? 'W' : '.';
+        moves += std::to_string(i) + ";";
+        std::string comment = i % 3 == 0 ? "" : std::string(i, 'c');
+        NetworkFramework::Message message(Op1, board, moves, comment);
+        client->Send(message);
+        Assert(client->Receive().value() == message);
+        client->Send(NetworkFramework::Message(Op2, board));
+        Assert(client->Receive().value() == NetworkFramework::Message(Op2, board));
+    }
+
+    // Edits of non-ASCII fields keep whole UTF-8 characters, e.g. when "é" (C3 A9) becomes "è" (C3 A8)
+    std::vector<std::string> texts = {"\u00e9\u00e9\u00e9\u00e9\u2026", "\u00e9\u00e8\u00e9\u00e9\u2026", "\u00e9\u00e8\u4e2d\u00e9\u2026",
+                                      "\u00e9\u00e8\u00e9\u2026", "\u00e8\u00e8\u00e9\u2025", "\U0001F600\u00e8\u00e9\u2025"};
+    for (auto& text : texts) {
+        client->Send(NetworkFramework::Message(Op3, text, text + text));
+        Assert(client->Receive().value() == NetworkFramework::Message(Op3, text, text + text));
+    }
+    // A frame that cannot be encoded is not sent, and the frames after it are still decoded
+    try {
+        client->Send(NetworkFramework::Message(Op3, "\xff"));
+        Assert(false);
+    } catch (const std::exception&) {
+    }
+    client->Send(NetworkFramework::Message(Op3, texts[0]));
+    Assert(client->Receive().value() == NetworkFramework::Message(Op3, texts[0]));
+    client->Close();
+}
+
+// Views decode the same fields as messages, escaped or not, and can be mixed with Receive() on one socket.
+void TestMessageView() {
+    constexpr int port = 7784;
+    NetworkFramework::Server server(std::make_shared<ViewEchoService>(), port);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+
+    // Fields with escape sequences are unescaped, the others refer to the receive buffer
+    std::vector<NetworkFramework::Message> messages = {
+        NetworkFramework::Message(Op1, "plain", "", "x"),
+        NetworkFramework::Message(-12345, "quote \" backslash \\ newline \n tab \t", "\x01\x1f", "\u00e9\u4e2d\U0001F600"),
+        NetworkFramework::Message(Op2, std::string(5000, 'z'), "{\"op\":1}", "\"op\":2}"),
+    };
+    client->Send(NetworkFramework::Message(OpExit, "dropped"));
+    for (auto& message : messages) {
+        client->Send(message);
+    }
+    for (auto& message : messages) {
+        auto view = client->ReceiveView();
+        Assert(view.has_value() && view->opcode == message.opcode);
+        Assert(view->Data1() == message.data1 && view->Data2() == message.data2 && view->Data3() == message.data3);
+        Assert(view->ToMessage() == message);
+    }
+
+    // Frames of other encoders, e.g. with \u escapes or whitespace
+    std::array<std::string, 3> storage;
+    NetworkFramework::MessageView escaped(Op1, R"({ "data1" : "\u00e9\ud83d\ude00", "data2":"a\/b", "data3":"", "op":1 })", &storage);
+    Assert(escaped.Data1() == "\u00e9\U0001F600" && escaped.Data2() == "a/b" && escaped.Data3() == "");
+    NetworkFramework::MessageView missing(Op1, R"({"data1":"a","data2":"b","op":1})", &storage);
+    bool thrown = false;
+    try {
+        missing.Data1();
+    } catch (const NetworkFramework::InvalidMessageException&) {
+        thrown = true;
+    }
+    Assert(thrown);
+
+    // Sockets that only implement Receive() return views of a copy
+    class QueueSocket : public NetworkFramework::Socket {
+       public:
+        std::vector<NetworkFramework::Message> queue;
+        void Send(NetworkFramework::Message message) override { queue.push_back(std::move(message)); }
+        std::optional<NetworkFramework::Message> Receive() override {
+            if (queue.empty()) {
+                return std::nullopt;
+            }
+            auto message = queue.front();
+            queue.erase(queue.begin());
+            return message;
+        }
+        void Close() override {}
+        std::string PeerAddress() const override { return "0.0.0.0"; }
+        int PeerPort() const override { return 0; }
+    } queue_socket;
+    queue_socket.Send(messages[1]);
+    auto copied = queue_socket.ReceiveView();
+    Assert(copied.has_value() && copied->ToMessage() == messages[1]);
+    Assert(queue_socket.ReceiveView().has_value() == false);
+
+    // Views and messages can be mixed, and delta frames are decoded when they are received
+    client->RequestDeltaEncoding();
+    for (int i = 0; i < 2; i++) {
+        for (auto& message : messages) {
+            client->Send(message);
+            Assert(client->Receive().value() == message);
+        }
+    }
+    client->Close();
+}
+
+// A sampled request and its reply form one trace, with the spans of both sides, in the Chrome trace export.
+void TestTracing() {
+    constexpr int port = 7785;
+    NetworkFramework::ClearTrace();
+    NetworkFramework::ServerOptions options;
+    options.connection.trace_sample_rate = 1;
+    NetworkFramework::Server server(std::make_shared<TracedEchoService>(), port);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, 3, options.connection);
+    client->Send(NetworkFramework::Message(Op1, "traced"));
+    Assert(client->Receive().value() == NetworkFramework::Message(Op1, "traced"));
+    auto trace_id = NetworkFramework::CurrentTraceId();
+    Assert(trace_id != 0);
+    client->Close();
+    Assert(client->Receive().has_value() == false);
+    Assert(NetworkFramework::CurrentTraceId() == 0);
+    while (server.ConnectionCount() != 0) {  // The server records its spans until it sees the close
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The request and the reply form one trace, with the spans of both sides
+    char trace_id_hex[24];
+    snprintf(trace_id_hex, sizeof(trace_id_hex), "\"0x%llx\"", static_cast<unsigned long long>(trace_id));
+    std::string trace = NetworkFramework::ExportChromeTrace();
+    for (auto name : {"encode", "wait", "send", "recv", "decode", "dispatch", "echo"}) {
+        Assert(trace.find(std::string("\"name\":\"") + name + "\"") != std::string::npos);
+    }
+    Assert(trace.find(trace_id_hex) != std::string::npos);
+    Assert(trace.find("\"ph\":\"s\"") != std::string::npos && trace.find("\"ph\":\"f\"") != std::string::npos);
+    NetworkFramework::ClearTrace();
+    Assert(NetworkFramework::ExportChromeTrace().find(trace_id_hex) == std::string::npos);
+}
+
+// Each rate limit action holds a peer to its limits, which the control messages of the framework count toward.
+void TestRateLimit() {
+    using namespace std::chrono_literals;
+    // Delay: the messages beyond the burst are held to the rate
+    {
+        constexpr int port = 7786;
+        NetworkFramework::ServerOptions options;
+        options.connection.receive_rate_limit.messages_per_second = 100;
+        options.connection.receive_rate_limit.message_burst = 5;
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < 25; i++) {
+            client->Send(NetworkFramework::Message(Op1, std::to_string(i)));
+        }
+        for (int i = 0; i < 25; i++) {
+            Assert(client->Receive().value() == NetworkFramework::Message(Op1, std::to_string(i)));
+        }
+        Assert(std::chrono::steady_clock::now() - start >= 180ms);
+        client->Close();
+    }
+    // Drop: the messages beyond the burst are skipped, until the bucket refills
+    {
+        constexpr int port = 7787;
+        NetworkFramework::ServerOptions options;
+        options.connection.receive_rate_limit.messages_per_second = 10;
+        options.connection.receive_rate_limit.message_burst = 3;
+        options.connection.receive_rate_limit.action = NetworkFramework::RateLimitAction::Drop;
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        for (int i = 0; i < 10; i++) {
+            client->Send(NetworkFramework::Message(Op1, std::to_string(i)));
+        }
+        for (int i = 0; i < 3; i++) {
+            Assert(client->Receive().value() == NetworkFramework::Message(Op1, std::to_string(i)));
+        }
+        std::this_thread::sleep_for(150ms);
+        client->Send(NetworkFramework::Message(Op2));
+        Assert(client->Receive().value() == NetworkFramework::Message(Op2));
+        client->Close();
+    }
+    // Disconnect: a peer that exceeds the byte rate is disconnected
+    {
+        constexpr int port = 7788;
+        NetworkFramework::ServerOptions options;
+        options.connection.receive_rate_limit.bytes_per_second = 1000;
+        options.connection.receive_rate_limit.action = NetworkFramework::RateLimitAction::Disconnect;
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        NetworkFramework::Message message(Op1, std::string(400, 'x'));
+        for (int i = 0; i < 5; i++) {
+            client->Send(message);
+        }
+        int echoed = 0;
+        try {
+            while (client->Receive().has_value()) {
+                echoed++;
+            }
+        } catch (const NetworkFramework::BrokenPipeException&) {
+            // The server may reset the connection with unread data
+        }
+        Assert(echoed == 2);
+        Assert(server.ReceiveMetrics().connection_limit_rejections == 1);
+    }
+    // Control messages count toward the limits too: heartbeat pongs toward the byte rate, and pings, which the
+    // server answers, toward the message rate. Unknown reserved opcodes disconnect the peer.
+    {
+        constexpr int port = 7791;
+        constexpr NetworkFramework::Opcode pong = std::numeric_limits<NetworkFramework::Opcode>::min() + 1;
+        NetworkFramework::ServerOptions options;
+        options.connection.receive_rate_limit.bytes_per_second = 1000;
+        options.connection.receive_rate_limit.action = NetworkFramework::RateLimitAction::Disconnect;
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        try {
+            for (int i = 0; i < 5; i++) {
+                client->Send(NetworkFramework::Message(pong, std::string(400, 'x')));
+            }
+            client->Send(NetworkFramework::Message(Op1));
+            Assert(client->Receive().has_value() == false);
+        } catch (const NetworkFramework::BrokenPipeException&) {
+            // The server may reset the connection before the last pongs are sent
+        }
+        Assert(server.ReceiveMetrics().connection_limit_rejections == 1);
+    }
+    {
+        constexpr int port = 7792;
+        constexpr NetworkFramework::Opcode ping = std::numeric_limits<NetworkFramework::Opcode>::min();
+        NetworkFramework::ServerOptions options;
+        options.connection.receive_rate_limit.messages_per_second = 10;
+        options.connection.receive_rate_limit.message_burst = 3;
+        options.connection.receive_rate_limit.action = NetworkFramework::RateLimitAction::Drop;
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        for (int i = 0; i < 10; i++) {
+            client->Send(NetworkFramework::Message(ping));
+        }
+        client->Send(NetworkFramework::Message(Op1));  // Dropped, since the pings took the burst
+        std::this_thread::sleep_for(150ms);
+        client->Send(NetworkFramework::Message(Op2));
+        Assert(client->Receive().value() == NetworkFramework::Message(Op2));
+
+        client->Send(NetworkFramework::Message(ping + 100));  // Reserved, but not a control message
+        try {
+            Assert(client->Receive().has_value() == false);
+        } catch (const NetworkFramework::BrokenPipeException&) {
+        }
+    }
+}
+
+// An urgent message overtakes a bulk record that is being sent, and the record is still reassembled.
+void TestPriorityLanes() {
+    constexpr int port = 7789;
+    NetworkFramework::Server server(std::make_shared<BulkRecordService>(), port);
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    client->Send(NetworkFramework::Message(Op1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // The urgent message overtakes the rest of the record, which is reassembled
+    Assert(client->Receive().value() == NetworkFramework::Message(OpExit, "urgent"));
+    Assert(client->Receive().value() == NetworkFramework::Message(Op3, std::string(8 << 20, 'r'), "\u00e9\u00e9\u00e9"));
+    client->Close();
+}
+
+// A peer that plays the chunks of bulk messages, to open many of them at once
+void TestBulkLimits() {
+    constexpr int port = 7773;
+    // OpChunk of src/private-include/control_opcodes.h
+    constexpr NetworkFramework::Opcode chunk = std::numeric_limits<NetworkFramework::Opcode>::min() + 4;
+    NetworkFramework::ServerOptions options;
+    options.connection.max_open_bulk_frames = 4;
+    options.connection.receive_rate_limit.messages_per_second = 10;
+    options.connection.receive_rate_limit.action = NetworkFramework::RateLimitAction::Disconnect;
+    options.receive_memory_budget = 4096;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+
+    // Each peer is disconnected before it sends all its chunks: by too many bulk messages at once,
+    // by too long IDs, and by too many chunks, even though they are empty
+    auto send_chunks = [&](std::vector<NetworkFramework::Message> chunks) {
+        auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+        try {
+            for (auto& message : chunks) {
+                client->Send(message);
+            }
+        } catch (const NetworkFramework::BrokenPipeException&) {
+        }
+        Assert(client->Receive().has_value() == false);
+    };
+    std::vector<NetworkFramework::Message> many_ids, long_ids, many_chunks;
+    for (int i = 0; i < 5; i++) {
+        many_ids.push_back(NetworkFramework::Message(chunk, std::to_string(i), "", "0"));
+    }
+    for (char c : {'a', 'b'}) {
+        long_ids.push_back(NetworkFramework::Message(chunk, std::string(3000, c), "", "0"));
+    }
+    for (int i = 0; i < 20; i++) {
+        many_chunks.push_back(NetworkFramework::Message(chunk, "0", "", "0"));
+    }
+    send_chunks(many_ids);
+    send_chunks(long_ids);
+    send_chunks(many_chunks);
+
+    auto metrics = server.ReceiveMetrics();
+    Assert(metrics.connection_limit_rejections == 2 && metrics.budget_rejections == 1);
+    while (server.ConnectionCount() != 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Assert(server.ReceiveMetrics().bytes_in_use == 0);
+}
+
+// A server and a client with every socket option set still exchange messages, and share the port where possible.
+void TestSocketOptions() {
+    constexpr int port = 7776;
+    NetworkFramework::ServerOptions options;
+    options.listen_backlog = 16;
+    options.reuse_port = true;
+    options.defer_accept = std::chrono::seconds(1);
+    options.fast_open_queue = 16;
+    options.connection.socket.no_delay = true;
+    options.connection.socket.quick_ack = true;
+    options.connection.socket.send_buffer_size = 256 << 10;
+    options.connection.socket.receive_buffer_size = 256 << 10;
+    NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+#ifdef SO_REUSEPORT
+    // Both servers share the port. Where SO_REUSEPORT does not exist, reuse_port is ignored.
+    NetworkFramework::Server second_server(std::make_shared<EchoService>(), port, options);
+    try {
+        NetworkFramework::Server exclusive_server(std::make_shared<EchoService>(), port);
+        Assert(false);
+    } catch (const NetworkFramework::BindPortException&) {
+    }
+#endif
+
+    NetworkFramework::ConnectOptions connect_options;
+    connect_options.connection.socket = options.connection.socket;
+    connect_options.fast_open = true;
+    connect_options.retry_count = 1;
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port, connect_options);
+    for (int i = 0; i < 10; i++) {
+        client->Send(NetworkFramework::Message(Op1, std::to_string(i)));
+        Assert(client->Receive().value() == NetworkFramework::Message(Op1, std::to_string(i)));
+    }
+    client->Close();
+}
+
+// A new server takes over the port and the connections, unless it fails before the end of the handover.
+void TestHandover() {
+#ifndef _WIN32
+    using namespace std::chrono_literals;
+    constexpr int port = 7775;
+    NetworkFramework::ServerOptions options;
+
+    // A file that is not a socket is not replaced by the handover socket
+    options.handover_path = "/tmp/network-framework-test-handover.txt";
+    std::ofstream(options.handover_path) << "not a socket";
+    try {
+        NetworkFramework::Server server(std::make_shared<EchoService>(), port, options);
+        Assert(false);
+    } catch (const NetworkFramework::BindPortException&) {
+    }
+    Assert(std::ifstream(options.handover_path).good());
+    std::remove(options.handover_path.c_str());
+
+    options.handover_path = "/tmp/network-framework-test-handover.sock";
+    options.hand_over_connections = true;
+    auto old_server = std::make_unique<NetworkFramework::Server>(std::make_shared<TaggedEchoService>("old", 300ms), port, options);
+    struct stat status;
+    Assert(lstat(options.handover_path.c_str(), &status) == 0 && (status.st_mode & 0777) == 0600);  // Only for the user
+    auto client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    client->Send(NetworkFramework::Message(Op1, "1"));
+    client->Send(NetworkFramework::Message(Op1, "2"));
+    Assert(client->Receive().value() == NetworkFramework::Message(Op1, "1", "old"));
+
+    // A new server that fails before it acknowledges the end of the handover leaves the connections to the old one.
+    // It acknowledges the listening socket, and exits once the connection is detached and sent.
+    std::thread failing_server([&]() {
+        int channel = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.handover_path.c_str(), sizeof(address.sun_path) - 1);
+        Assert(connect(channel, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+        char record[256];
+        Assert(recv(channel, record, sizeof(record), 0) > 0);  // The listening socket, closed without being received
+        Assert(send(channel, "1", 1, 0) == 1);
+        std::this_thread::sleep_for(600ms);
+        close(channel);
+    });
+    Assert(client->Receive().value() == NetworkFramework::Message(Op1, "2", "old"));
+    failing_server.join();
+
+    // The next message waits while the old service handles the previous one, and goes to the new server
+    client->Send(NetworkFramework::Message(Op1, "3"));
+    NetworkFramework::Server new_server(std::make_shared<TaggedEchoService>("new", 0ms), port, options);
+    Assert(old_server->WaitForHandover());
+    Assert(client->Receive().value() == NetworkFramework::Message(Op1, "3", "new"));
+    auto new_client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    new_client->Send(NetworkFramework::Message(Op2, "4"));
+    Assert(new_client->Receive().value() == NetworkFramework::Message(Op2, "4", "new"));
+
+    // Shutting the old server down closes neither the port nor the connections that it handed over
+    old_server.reset();
+    client->Send(NetworkFramework::Message(Op1, "5"));
+    Assert(client->Receive().value() == NetworkFramework::Message(Op1, "5", "new"));
+    client->Close();
+    new_client->Close();
+#endif
+}
+
+// Pipelined requests are answered out of order, each response finds its request, and a closed connection fails the rest.
+void TestRpc() {
+    using namespace std::chrono_literals;
+    constexpr int port = 7774;
+    // Sleeps for data2 milliseconds, and fails on OpError
+    auto service = std::make_shared<NetworkFramework::RpcService>(
+        [](const NetworkFramework::Message& request) {
+            if (request.opcode == OpError) {
+                throw std::runtime_error("failed");
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::stoi(request.data2)));
+            return NetworkFramework::Message(request.opcode, request.data1);
+        },
+        NetworkFramework::RpcServiceOptions{4, 16});
+    NetworkFramework::Server server(service, port);
+
+    // The slow request is answered last, and each response finds its request
+    NetworkFramework::RpcClient client(NetworkFramework::ConnectToServer("127.0.0.1", port));
+    auto slow = client.Call(NetworkFramework::Message(Op1, "slow", "200"));
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::promise<void> all_fast;
+    for (int i = 0; i < 3; i++) {
+        client.Call(NetworkFramework::Message(Op2, std::to_string(i), "0"), [&](std::optional<NetworkFramework::Message> response) {
+            std::lock_guard lk(mutex);
+            Assert(response.has_value() && response->opcode == Op2);
+            order.push_back(response->data1);
+            if (order.size() == 3) {
+                all_fast.set_value();
+            }
+        });
+    }
+    all_fast.get_future().wait();
+    Assert(slow.wait_for(0s) != std::future_status::ready);
+    NetworkFramework::Message slow_response = slow.get();
+    Assert(slow_response.data1 == "slow" && slow_response.correlation_id == 1);
+    Assert(client.PendingCount() == 0);
+
+    // The correlation ID is also seen by plain sockets and views
+    auto plain_client = NetworkFramework::ConnectToServer("127.0.0.1", port);
+    NetworkFramework::Message request(Op3, "plain", "0");
+    request.correlation_id = 1234567890123;
+    plain_client->Send(request);
+    auto view = plain_client->ReceiveView();
+    Assert(view.has_value() && view->correlation_id == request.correlation_id);
+    NetworkFramework::Message response(Op3, "plain");
+    response.correlation_id = request.correlation_id;
+    Assert(view->ToMessage() == response);
+    plain_client->Close();
+
+    // A client can be destroyed in its own callback, which fails its other pending requests
+    auto owned = std::make_unique<NetworkFramework::RpcClient>(NetworkFramework::ConnectToServer("127.0.0.1", port));
+    auto unanswered = owned->Call(NetworkFramework::Message(Op1, "unanswered", "300"));
+    std::promise<void> destroyed;
+    owned->Call(NetworkFramework::Message(Op2, "destroying", "0"), [&](std::optional<NetworkFramework::Message>) {
+        owned.reset();
+        destroyed.set_value();
+    });
+    destroyed.get_future().wait();
+    try {
+        unanswered.get();
+        Assert(false);
+    } catch (const NetworkFramework::BrokenPipeException&) {
+    }
+
+    // A failed request closes the connection, which fails the other pending requests
+    auto pending = client.Call(NetworkFramework::Message(Op1, "pending", "300"));
+    auto failed = client.Call(NetworkFramework::Message(OpError));
+    for (auto* future : {&pending, &failed}) {
+        try {
+            future->get();
+            Assert(false);
+        } catch (const NetworkFramework::BrokenPipeException&) {
+        }
+    }
+    bool called = false;
+    client.Call(NetworkFramework::Message(Op1, "late", "0"), [&](std::optional<NetworkFramework::Message> response) {
+        called = response.has_value() == false;
+    });
+    Assert(called);
+}
+
 int main() {
     constexpr int port = 7777;
 
@@ -137,5 +946,20 @@ int main() {
     // Manual shutdown is not necessary, since Shutdown() is called in the destructor.
     // However, shutdown manually is also supported.
     server.Shutdown();
+
+    TestReceiveLimits();
+    TestIdleTimeout();
+    TestTypedMessages();
+    TestMatchmaker();
+    TestIoUringBackend();
+    TestDeltaEncoding();
+    TestMessageView();
+    TestTracing();
+    TestRateLimit();
+    TestPriorityLanes();
+    TestBulkLimits();
+    TestSocketOptions();
+    TestHandover();
+    TestRpc();
     return 0;
 }
@@ -0,0 +1,296 @@
+/*
+ *  Description: This file implements the tracing defined in include/tracing.h,
+ *               and the recorder declared in src/private-include/trace_recorder.h
+ *
+ *  Author(s):
+ *      Nictheboy Li    <nictheboy@outlook.com>
+ *
+ *  License:
+ *      MIT License, feel free to use and modify this file!
+ *
+ */
+
+#include "tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "trace_recorder.h"
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace NetworkFramework {
+
+namespace {
+
+// The number of recent spans kept per thread
+constexpr std::uint64_t kSpansPerThread = 4096;
+
+// Trace IDs fit in the mantissa of a double, so that any JSON parser of the peer keeps them exact
+constexpr std::uint64_t kTraceIdMask = (std::uint64_t(1) << 53) - 1;
+
+struct Span {
+    const char* name;
+    std::uint64_t trace_id;
+    Opcode opcode;
+    std::uint64_t start;
+    std::uint64_t end;
+    std::uint64_t arg;
+    int thread;
+};
+
+// A span that is written by its thread under a sequence lock, so that ExportChromeTrace() can read it meanwhile
+struct SpanSlot {
+    std::atomic<std::uint64_t> sequence{0};  // 2 * n + 2 once the n-th span of the thread is written, odd while writing
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::uint64_t> trace_id{0};
+    std::atomic<Opcode> opcode{0};
+    std::atomic<std::uint64_t> start{0};
+    std::atomic<std::uint64_t> end{0};
+    std::atomic<std::uint64_t> arg{0};
+    std::atomic<int> thread{0};
+};
+
+// The recent spans of one thread, in a ring. Only that thread writes to it.
+// When the thread exits, the ring is passed on to a new thread, with the spans that it keeps.
+class ThreadBuffer {
+   private:
+    std::unique_ptr<SpanSlot[]> slots_;
+    std::atomic<std::uint64_t> written_{0};
+    std::atomic<std::uint64_t> cleared_{0};  // The spans before it are dropped by ClearTrace()
+
+   public:
+    ThreadBuffer() : slots_(std::make_unique<SpanSlot[]>(kSpansPerThread)) {}
+
+    void Write(int thread, const char* name, std::uint64_t trace_id, Opcode opcode, std::uint64_t start,
+               std::uint64_t end, std::uint64_t arg) {
+        std::uint64_t index = written_.load(std::memory_order_relaxed);
+        SpanSlot& slot = slots_[index % kSpansPerThread];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.trace_id.store(trace_id, std::memory_order_relaxed);
+        slot.opcode.store(opcode, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.arg.store(arg, std::memory_order_relaxed);
+        slot.thread.store(thread, std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+        written_.store(index + 1, std::memory_order_release);
+    }
+
+    // Append the spans that are complete, skipping those that the thread overwrites meanwhile.
+    void Read(std::vector<Span>& spans) const {
+        std::uint64_t written = written_.load(std::memory_order_acquire);
+        std::uint64_t first = std::max(cleared_.load(std::memory_order_relaxed),
+                                       written > kSpansPerThread ? written - kSpansPerThread : 0);
+        for (std::uint64_t index = first; index < written; index++) {
+            const SpanSlot& slot = slots_[index % kSpansPerThread];
+            std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if (sequence != 2 * index + 2) {
+                continue;
+            }
+            Span span{slot.name.load(std::memory_order_relaxed),
+                      slot.trace_id.load(std::memory_order_relaxed),
+                      slot.opcode.load(std::memory_order_relaxed),
+                      slot.start.load(std::memory_order_relaxed),
+                      slot.end.load(std::memory_order_relaxed),
+                      slot.arg.load(std::memory_order_relaxed),
+                      slot.thread.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+                spans.push_back(span);
+            }
+        }
+    }
+
+    void Clear() {
+        cleared_.store(written_.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+};
+
+// The buffers of all threads that have recorded a span. The buffers of exited threads are reused by new threads,
+// so there are no more buffers than threads that record spans at once, e.g. one per connection of a server.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::vector<std::shared_ptr<ThreadBuffer>> free_buffers;  // Also in buffers, so their spans are still exported
+    int next_thread = 1;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+struct ThreadState {
+    std::shared_ptr<ThreadBuffer> buffer;  // Taken by the first span of the thread
+    int thread = 0;
+    std::uint64_t trace_id = 0;            // The trace of the message being dispatched
+    Opcode opcode = 0;
+    std::uint64_t dispatch_start = 0;
+    std::uint64_t random = 0;
+
+    ~ThreadState() {
+        if (buffer) {
+            auto& registry = GetRegistry();
+            std::lock_guard lk(registry.mutex);
+            registry.free_buffers.push_back(std::move(buffer));
+        }
+    }
+};
+
+thread_local ThreadState thread_state;
+
+ThreadBuffer& BufferOfThisThread() {
+    if (!thread_state.buffer) {
+        auto& registry = GetRegistry();
+        std::lock_guard lk(registry.mutex);
+        thread_state.thread = registry.next_thread++;
+        if (registry.free_buffers.empty() == false) {
+            thread_state.buffer = std::move(registry.free_buffers.back());
+            registry.free_buffers.pop_back();
+        } else {
+            thread_state.buffer = std::make_shared<ThreadBuffer>();
+            registry.buffers.push_back(thread_state.buffer);
+        }
+    }
+    return *thread_state.buffer;
+}
+
+// xorshift64*, seeded once per thread
+std::uint64_t NextRandom() {
+    auto& x = thread_state.random;
+    if (x == 0) {
+        x = (std::uint64_t(std::random_device()()) << 32) ^ TraceRecorder::Now() ^ reinterpret_cast<std::uintptr_t>(&x);
+        x = x == 0 ? 1 : x;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+std::string HexId(std::uint64_t id) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(id));
+    return buffer;
+}
+
+}  // namespace
+
+}  // namespace NetworkFramework
+
+void NetworkFramework::TraceRecorder::Record(const char* name, std::uint64_t trace_id, Opcode opcode, std::uint64_t start,
+                                             std::uint64_t end, std::uint64_t arg) {
+    auto& buffer = BufferOfThisThread();
+    buffer.Write(thread_state.thread, name, trace_id, opcode, start, end, arg);
+}
+
+std::uint64_t NetworkFramework::TraceRecorder::Sample(double rate) {
+    if ((NextRandom() >> 11) * 0x1.0p-53 >= rate) {
+        return 0;
+    }
+    std::uint64_t id;
+    do {
+        id = NextRandom() & kTraceIdMask;
+    } while (id == 0);
+    return id;
+}
+
+void NetworkFramework::TraceRecorder::BeginDispatch(std::uint64_t trace_id, Opcode opcode, std::uint64_t now) {
+    thread_state.trace_id = trace_id;
+    thread_state.opcode = opcode;
+    thread_state.dispatch_start = now;
+}
+
+void NetworkFramework::TraceRecorder::EndDispatch() {
+    if (thread_state.trace_id != 0) {
+        Record("dispatch", thread_state.trace_id, thread_state.opcode, thread_state.dispatch_start, Now());
+        thread_state.trace_id = 0;
+    }
+}
+
+std::uint64_t NetworkFramework::CurrentTraceId() {
+    return thread_state.trace_id;
+}
+
+NetworkFramework::TraceSpan::TraceSpan(const char* name)
+    : name_(name), trace_id_(thread_state.trace_id), start_(trace_id_ != 0 ? TraceRecorder::Now() : 0) {}
+
+NetworkFramework::TraceSpan::~TraceSpan() {
+    if (trace_id_ != 0) {
+        TraceRecorder::Record(name_, trace_id_, thread_state.opcode, start_, TraceRecorder::Now());
+    }
+}
+
+std::string NetworkFramework::ExportChromeTrace() {
+    std::vector<Span> spans;
+    {
+        auto& registry = GetRegistry();
+        std::lock_guard lk(registry.mutex);
+        for (auto& buffer : registry.buffers) {
+            buffer->Read(spans);
+        }
+    }
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.start < b.start; });
+
+    int pid = static_cast<int>(getpid());
+    nlohmann::json events = nlohmann::json::array();
+    std::unordered_map<std::uint64_t, std::vector<const Span*>> traces;
+    for (auto& span : spans) {
+        nlohmann::json args = {{"trace_id", HexId(span.trace_id)}, {"opcode", span.opcode}};
+        if (span.arg != 0) {
+            args["peer_sent_at_us"] = span.arg / 1000.0;
+        }
+        events.push_back({{"name", span.name},
+                          {"cat", "network"},
+                          {"ph", "X"},
+                          {"ts", span.start / 1000.0},
+                          {"dur", (span.end - span.start) / 1000.0},
+                          {"pid", pid},
+                          {"tid", span.thread},
+                          {"args", std::move(args)}});
+        traces[span.trace_id].push_back(&span);
+    }
+    // Flow arrows from each span of a trace to the next one
+    for (auto& [trace_id, trace_spans] : traces) {
+        for (std::size_t i = 0; trace_spans.size() > 1 && i < trace_spans.size(); i++) {
+            const char* phase = i == 0 ? "s" : i + 1 == trace_spans.size() ? "f" : "t";
+            nlohmann::json flow = {{"name", "message"},
+                                   {"cat", "network"},
+                                   {"ph", phase},
+                                   {"id", HexId(trace_id)},
+                                   {"ts", trace_spans[i]->start / 1000.0},
+                                   {"pid", pid},
+                                   {"tid", trace_spans[i]->thread}};
+            if (i + 1 == trace_spans.size()) {
+                flow["bp"] = "e";
+            }
+            events.push_back(std::move(flow));
+        }
+    }
+    nlohmann::json trace = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ns"}};
+    return trace.dump();
+}
+
+void NetworkFramework::ClearTrace() {
+    auto& registry = GetRegistry();
+    std::lock_guard lk(registry.mutex);
+    for (auto& buffer : registry.free_buffers) {
+        registry.buffers.erase(std::find(registry.buffers.begin(), registry.buffers.end(), buffer));
+    }
+    registry.free_buffers.clear();
+    for (auto& buffer : registry.buffers) {
+        buffer->Clear();
+    }
+}